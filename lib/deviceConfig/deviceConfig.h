@@ -4,6 +4,28 @@
 #include <Arduino.h>
 #include <cmath>
 #include <map>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "keypadLayout.h"
+
+// The config is changed from the motion task (line coordinates, max position) and the
+// network task (WiFi credentials), and saved from both. Hold a DeviceConfigLock around
+// every change and around a save, so a save never sees the config half-changed and
+// two saves never write the file at the same time. Recursive: a save may run inside.
+inline SemaphoreHandle_t deviceConfigMutex() {
+    static SemaphoreHandle_t mutex = xSemaphoreCreateRecursiveMutex();
+    return mutex;
+}
+
+class DeviceConfigLock {
+public:
+    DeviceConfigLock() { xSemaphoreTakeRecursive(deviceConfigMutex(), portMAX_DELAY); }
+    ~DeviceConfigLock() { xSemaphoreGiveRecursive(deviceConfigMutex()); }
+
+private:
+    DeviceConfigLock(const DeviceConfigLock&);
+    DeviceConfigLock& operator=(const DeviceConfigLock&);
+};
 
 // Functions
 void printConfig();
@@ -19,6 +41,7 @@ void setWiFiCredentials(const String& ssid, const String& password);
 void setMaxPosition(float mm);
 void setLineCoordinate(int index, float mm);
 void setLineCoordinates(const std::map<int,float>& coords);
+void setKeypadLayout(const KeypadLayout& layout);
 
 String getDeviceName();
 String getDeviceID();
@@ -28,5 +51,6 @@ String getWiFiPassword();
 float getMaxPosition();
 const std::map<int, float>& getLineCoordinates();
 float getLineCoordinate(int index);
+const KeypadLayout& getKeypadLayout();
 
 #endif // DEVICE_CONFIG_H
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef KEYPAD_LAYOUT_H
+#define KEYPAD_LAYOUT_H
+
+#include <stdint.h>
+
+#define KEYPAD_MAX_BUTTONS 16
+#define KEYPAD_MAX_LINES 8
+
+// Where a keypad button is: the line (row) the carriage stops at and the servo above it.
+// pressAngle and holdMs override that servo's profile for this key only, 0 = servo default.
+struct KeyBinding {
+    uint8_t line;       // 1..KEYPAD_MAX_LINES, 0 = button not on this keypad
+    uint8_t servo;      // 1 = left, 2 = middle, 3 = right
+    uint8_t pressAngle;
+    uint16_t holdMs;
+};
+
+// Indexed by button number, so a lookup is a single array access
+struct KeypadLayout {
+    uint8_t buttonCount;
+    KeyBinding keys[KEYPAD_MAX_BUTTONS];
+};
+
+// Standard meter keypad: 1-9 on lines 1-3, then Backspace / 0 / Submit on line 4
+constexpr KeypadLayout DEFAULT_KEYPAD_LAYOUT = {
+    12,
+    {
+        {4, 2, 0, 0}, // 0 (Clear)
+        {1, 1, 0, 0}, // 1
+        {1, 2, 0, 0}, // 2
+        {1, 3, 0, 0}, // 3
+        {2, 1, 0, 0}, // 4
+        {2, 2, 0, 0}, // 5
+        {2, 3, 0, 0}, // 6
+        {3, 1, 0, 0}, // 7
+        {3, 2, 0, 0}, // 8
+        {3, 3, 0, 0}, // 9
+        {4, 1, 0, 0}, // 10 Backspace
+        {4, 3, 0, 0}, // 11 Submit
+    }
+};
+
+inline bool sameKeypadLayout(const KeypadLayout& a, const KeypadLayout& b) {
+    if (a.buttonCount != b.buttonCount) return false;
+    for (uint8_t i = 0; i < a.buttonCount; i++) {
+        const KeyBinding& x = a.keys[i];
+        const KeyBinding& y = b.keys[i];
+        if (x.line != y.line || x.servo != y.servo || x.pressAngle != y.pressAngle || x.holdMs != y.holdMs) return false;
+    }
+    return true;
+}
+
+#endif // KEYPAD_LAYOUT_H
@@ -1,13 +1,13 @@
 #include "fsManager.h"
 
 void FSManager::init() {
-    if (!LittleFS.begin(FORMAT_LITTLEFS_IF_FAILED)) {
+    if (!halFS().begin(FORMAT_LITTLEFS_IF_FAILED)) {
         Serial.println("Failed to mount or format LittleFS. Please check the filesystem.");
         return;
     }
     Serial.println("LittleFS initialized successfully.");
 
-    if(!LittleFS.exists("/config.json")) {
+    if(!halFS().exists("/config.json")) {
         Serial.println("Config file does not exist. Creating default config.");
         saveConfig();
     } else {
@@ -17,6 +17,7 @@ void FSManager::init() {
 }
 
 void FSManager::saveConfig() {
+    DeviceConfigLock lock;
     JsonDocument doc;
 
     doc["deviceName"] = getDeviceName();
@@ -28,8 +29,24 @@ void FSManager::saveConfig() {
     for (const auto& pair : getLineCoordinates()) {
         lineCoords[String(pair.first)] = pair.second;
     }
+    const KeypadLayout& layout = getKeypadLayout();
+    JsonArray keypad = doc["keypad"].to<JsonArray>();
+    for (uint8_t i = 0; i < layout.buttonCount; i++) {
+        const KeyBinding& key = layout.keys[i];
+        if (key.line == 0) {
+            keypad.add(nullptr);
+            continue;
+        }
+        JsonArray entry = keypad.add<JsonArray>();
+        entry.add(key.line);
+        entry.add(key.servo);
+        if (key.pressAngle || key.holdMs) {
+            entry.add(key.pressAngle);
+            entry.add(key.holdMs);
+        }
+    }
 
-    File file = LittleFS.open("/config.json", "w");
+    File file = halFS().open("/config.json", "w");
     if (!file) {
         Serial.println("Failed to open config file for writing.");
         return;
@@ -45,12 +62,12 @@ void FSManager::saveConfig() {
 }
 
 void FSManager::loadConfig() {
-    if (!LittleFS.exists("/config.json")) {
+    if (!halFS().exists("/config.json")) {
         Serial.println("Config file does not exist. Please save/create the config first.");
         return;
     }
 
-    File file = LittleFS.open("/config.json", "r");
+    File file = halFS().open("/config.json", "r");
     if (!file) {
         Serial.println("Failed to open config file for reading.");
         return;
@@ -64,6 +81,7 @@ void FSManager::loadConfig() {
         return;
     }
 
+    DeviceConfigLock lock;
     setDeviceName(doc["deviceName"].as<String>());
     setDeviceID(doc["deviceID"].as<String>());
     setWiFiCredentials(doc["wifiSSID"].as<String>(), doc["wifiPassword"].as<String>());
@@ -79,17 +97,23 @@ void FSManager::loadConfig() {
     }
     setLineCoordinates(newCoords);
 
+    if (!doc["keypad"].isNull()) {
+        KeypadLayout layout;
+        if (parseKeypadLayout(doc["keypad"], layout)) setKeypadLayout(layout);
+        else Serial.println("Invalid keypad layout in config. Using previous layout.");
+    }
+
     Serial.println("Config loaded successfully.\n");
     file.close();
 }
 
 void FSManager::readConfig() {
-    if (!LittleFS.exists("/config.json")) {
+    if (!halFS().exists("/config.json")) {
         Serial.println("Config file does not exist.");
         return;
     }
 
-    File file = LittleFS.open("/config.json", "r");
+    File file = halFS().open("/config.json", "r");
     if (!file) {
         Serial.println("Failed to open config file for reading.");
         return;
@@ -107,8 +131,37 @@ void FSManager::readConfig() {
     file.close();
 }
 
+bool FSManager::parseKeypadLayout(JsonVariantConst src, KeypadLayout& layout) {
+    JsonArrayConst keys = src.as<JsonArrayConst>();
+    if (keys.isNull() || keys.size() == 0 || keys.size() > KEYPAD_MAX_BUTTONS) return false;
+
+    layout = KeypadLayout();
+    layout.buttonCount = keys.size();
+    uint8_t button = 0;
+    for (JsonVariantConst entry : keys) {
+        KeyBinding& key = layout.keys[button++];
+        if (entry.isNull()) continue; // gap in the button numbering
+
+        JsonArrayConst fields = entry.as<JsonArrayConst>();
+        if (fields.size() < 2) return false;
+        int line = fields[0] | 0;
+        int servo = fields[1] | 0;
+        int pressAngle = fields[2] | 0;
+        int holdMs = fields[3] | 0;
+        if (line < 1 || line > KEYPAD_MAX_LINES || servo < 1 || servo > SERVO_COUNT || pressAngle < 0 || pressAngle > 180 ||
+            holdMs < 0 || holdMs > UINT16_MAX) {
+            return false;
+        }
+        key.line = line;
+        key.servo = servo;
+        key.pressAngle = pressAngle;
+        key.holdMs = holdMs;
+    }
+    return true;
+}
+
 void FSManager::formatFS() {
-    if (LittleFS.format()) {
+    if (halFS().format()) {
         Serial.println("LittleFS formatted successfully.\n");
     } else {
         Serial.println("Failed to format LittleFS.\n");
@@ -3,9 +3,9 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
-#include <LittleFS.h>
-#include "FS.h"
+#include "hal.h"
 #include "deviceConfig.h"
+#include "motorConfig.h"
 
 #define FORMAT_LITTLEFS_IF_FAILED true
 
@@ -16,6 +16,9 @@ public:
     void loadConfig();
     void readConfig();
     void formatFS();
+
+    // "keypad": [[line, servo], [line, servo, pressAngle, holdMs], ...] indexed by button, null = no button
+    static bool parseKeypadLayout(JsonVariantConst src, KeypadLayout& layout);
 };
 
 #endif // FS_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef HAL_H
+#define HAL_H
+
+// Hardware abstraction for everything in lib/. On the ESP32 (halEsp32.h) each call is an
+// inline call into the Arduino core, so the firmware compiles to the same code as before.
+// On the host (halNative.h, env:native) the same calls go to backend interfaces that the
+// fakes in halFakes.h implement by default and a simulator can replace.
+//
+//   time        halMillis, halMicros, halDelay, halTimeUs, halStartTimeSync
+//   GPIO        halPinMode, halDigitalWrite, halDigitalRead, halAttachInterrupt
+//   step timer  HalStepTimer
+//   servo PWM   HalServo
+//   filesystem  halFS(): begin, format, exists, open, remove; File
+//   network     halWiFi(): the part of the WiFi API used here; HalNetClient, HalNetServer, HalDnsServer
+//   system      halCleanReset, halRestart, HAL_RETAINED
+//
+// The FreeRTOS queue and task calls are not part of the HAL; the host provides a
+// single-threaded stand-in for them (lib/hal/native/freertos).
+#if defined(ARDUINO_ARCH_ESP32)
+#include "halEsp32.h"
+#else
+#include "halNative.h"
+#endif
+
+#endif // HAL_H
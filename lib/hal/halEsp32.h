@@ -0,0 +1,76 @@
+#ifndef HAL_ESP32_H
+#define HAL_ESP32_H
+
+#include <Arduino.h>
+#include <DNSServer.h>
+#include <ESP32Servo.h>
+#include <LittleFS.h>
+#include <WiFi.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+
+#define HAL_RETAINED RTC_NOINIT_ATTR // Survives software resets, not power loss
+
+//* TIME
+static inline unsigned long halMillis() { return millis(); }
+static inline unsigned long IRAM_ATTR halMicros() { return micros(); }
+static inline void halDelay(unsigned long ms) { delay(ms); }
+static inline int64_t IRAM_ATTR halTimeUs() { return esp_timer_get_time(); }
+static inline void halStartTimeSync(const char* server) { configTime(0, 0, server); } // UTC, via SNTP
+
+//* GPIO
+static inline void halPinMode(uint8_t pin, uint8_t mode) { pinMode(pin, mode); }
+static inline void IRAM_ATTR halDigitalWrite(uint8_t pin, uint8_t level) { digitalWrite(pin, level); }
+static inline int IRAM_ATTR halDigitalRead(uint8_t pin) { return digitalRead(pin); }
+static inline void halAttachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+    attachInterrupt(digitalPinToInterrupt(pin), isr, mode);
+}
+
+//* STEP TIMER
+// Hardware timer counting microseconds; the alarm reloads until stop(), and an alarm
+// written from the ISR sets the length of the period that just began
+class HalStepTimer {
+public:
+    HalStepTimer() : timer(nullptr) {}
+
+    void begin(uint8_t num, void (*isr)()) {
+        if (timer) return;
+        // 80 MHz APB / 80 = 1 tick per microsecond
+        timer = timerBegin(num, 80, true);
+        timerAttachInterrupt(timer, isr, true);
+    }
+    bool isReady() const { return timer != nullptr; }
+
+    void start(uint32_t firstUs) {
+        timerWrite(timer, 0);
+        timerAlarmWrite(timer, firstUs, true);
+        timerAlarmEnable(timer);
+    }
+    void IRAM_ATTR setAlarm(uint32_t us) { timerAlarmWrite(timer, us, true); }
+    void IRAM_ATTR stop() { timerAlarmDisable(timer); }
+
+private:
+    hw_timer_t* timer;
+};
+
+//* SERVO PWM
+typedef Servo HalServo;
+
+//* FILESYSTEM
+static inline fs::LittleFSFS& halFS() { return LittleFS; }
+
+//* NETWORK
+typedef WiFiClient HalNetClient;
+typedef WiFiServer HalNetServer;
+typedef DNSServer HalDnsServer;
+static inline WiFiClass& halWiFi() { return WiFi; }
+
+//* SYSTEM
+// Software reset or deep sleep wake: RAM marked HAL_RETAINED still holds what was written
+static inline bool halCleanReset() {
+    esp_reset_reason_t reason = esp_reset_reason();
+    return reason == ESP_RST_SW || reason == ESP_RST_DEEPSLEEP;
+}
+static inline void halRestart() { ESP.restart(); }
+
+#endif // HAL_ESP32_H
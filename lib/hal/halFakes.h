@@ -0,0 +1,141 @@
+#ifndef HAL_FAKES_H
+#define HAL_FAKES_H
+
+// Default host backends for halNative.h. Time is virtual: it only moves in delays,
+// and the step timer fires inside them at its exact alarm times, so motion code
+// sees the same interleaving of ISR and task as on the board, minus the jitter.
+
+#include "hal.h"
+
+#define HAL_PIN_COUNT 40
+
+class FakeTimer : public HalTimer {
+public:
+    FakeTimer() : isr(nullptr), armed(false), periodUs(0), dueUs(0), fired(0) {}
+
+    void attach(void (*isr)()) override { this->isr = isr; }
+    void start(uint32_t firstUs) override;
+    void setAlarm(uint32_t us) override { periodUs = us; } // Length of the period that began with this alarm
+    void stop() override { armed = false; }
+
+    bool isArmed() const { return armed; }
+    uint64_t getDueUs() const { return dueUs; }
+    uint64_t getFired() const { return fired; }
+    void fire(); // Runs the ISR at getDueUs(), the clock must already be there
+
+private:
+    void (*isr)();
+    bool armed;
+    uint32_t periodUs;
+    uint64_t dueUs;
+    uint64_t fired;
+};
+
+class VirtualClock : public HalClock {
+public:
+    VirtualClock() : now(0), timer(nullptr) {}
+
+    uint64_t nowUs() override { return now; }
+    void delayUs(uint64_t us) override;
+    void attachTimer(FakeTimer* timer) { this->timer = timer; }
+
+private:
+    uint64_t now;
+    FakeTimer* timer;
+};
+
+// Pin levels; inputs read HIGH (pulled up, switch open) until set() drives them
+class FakeGpio : public HalGpio {
+public:
+    FakeGpio();
+
+    void pinMode(uint8_t pin, uint8_t mode) override;
+    void digitalWrite(uint8_t pin, uint8_t level) override;
+    int digitalRead(uint8_t pin) override { return pin < HAL_PIN_COUNT ? level[pin] : LOW; }
+    void attachInterrupt(uint8_t pin, void (*isr)(), int mode) override;
+
+    void set(uint8_t pin, uint8_t level); // External signal, runs the pin's ISR on a matching edge
+    uint32_t getWrites(uint8_t pin) const { return pin < HAL_PIN_COUNT ? writes[pin] : 0; }
+
+protected:
+    uint8_t level[HAL_PIN_COUNT];
+    bool driven[HAL_PIN_COUNT];
+    uint32_t writes[HAL_PIN_COUNT];
+    void (*isr[HAL_PIN_COUNT])();
+    int isrMode[HAL_PIN_COUNT];
+
+    void change(uint8_t pin, uint8_t newLevel);
+};
+
+class FakeServoDriver : public HalServoDriver {
+public:
+    FakeServoDriver();
+
+    void attach(int pin) override;
+    void write(int pin, int angle) override;
+
+    int getAngle(int pin) const { return pin >= 0 && pin < HAL_PIN_COUNT ? angle[pin] : -1; }
+
+private:
+    int angle[HAL_PIN_COUNT]; // -1 = not attached
+};
+
+// LittleFS paths mapped into a host directory (flat, like the files used here)
+class HostFilesystem : public HalFilesystem {
+public:
+    explicit HostFilesystem(const char* root = ".native_fs");
+
+    bool begin(bool formatOnFail) override;
+    bool format() override;
+    bool exists(const char* path) override;
+    bool remove(const char* path) override;
+    File open(const char* path, const char* mode) override;
+
+private:
+    String root;
+
+    String hostPath(const char* path) const;
+};
+
+// Station that joins any network at once. No TCP: connections are refused unless a
+// subclass overrides openConnection()/acceptConnection().
+class FakeWiFi : public HalWiFi {
+public:
+    FakeWiFi() : wifiMode(WIFI_OFF), joined(false), reachable(true) {}
+
+    bool mode(uint8_t mode) override;
+    void begin(const char* ssid, const char* pass) override;
+    bool disconnect(bool wifiOff = false) override;
+    uint8_t status() override { return joined ? WL_CONNECTED : WL_DISCONNECTED; }
+    IPAddress localIP() override { return joined ? IPAddress(192, 168, 1, 50) : IPAddress(); }
+    String macAddress() override { return "02:00:00:00:00:01"; }
+    bool softAPConfig(IPAddress, IPAddress, IPAddress) override { return true; }
+    bool softAP(const char*) override { return true; }
+    IPAddress softAPIP() override { return IPAddress(192, 168, 4, 1); }
+    int16_t scanNetworks() override { return 0; }
+    String SSID(uint8_t) override { return String(); }
+    int32_t RSSI(uint8_t) override { return 0; }
+
+    Client* openConnection(IPAddress, uint16_t) override { return nullptr; }
+    Client* acceptConnection(uint16_t) override { return nullptr; }
+
+    void setReachable(bool reachable); // false = the access point is gone, drops the link
+
+private:
+    uint8_t wifiMode;
+    bool joined;
+    bool reachable;
+};
+
+struct HalFakes {
+    VirtualClock clock;
+    FakeTimer timer;
+    FakeGpio gpio;
+    FakeServoDriver servos;
+    HostFilesystem fs;
+    FakeWiFi wifi;
+};
+
+HalFakes& halFakes(); // The backends in use until a halSet*() call replaces one
+
+#endif // HAL_FAKES_H
@@ -0,0 +1,191 @@
+#ifndef ARDUINO_ARCH_ESP32
+
+#include "halFakes.h"
+#include <stdlib.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//* FAKES
+void FakeTimer::start(uint32_t firstUs) {
+    periodUs = firstUs;
+    dueUs = halClock().nowUs() + firstUs;
+    armed = true;
+}
+
+void FakeTimer::fire() {
+    fired++;
+    if (isr) isr();
+    if (armed) dueUs += periodUs; // Auto-reload, with the alarm the ISR may just have written
+}
+
+void VirtualClock::delayUs(uint64_t us) {
+    uint64_t until = now + us;
+    while (timer && timer->isArmed() && timer->getDueUs() <= until) {
+        now = timer->getDueUs();
+        timer->fire();
+    }
+    now = until;
+}
+
+FakeGpio::FakeGpio() {
+    for (uint8_t pin = 0; pin < HAL_PIN_COUNT; pin++) {
+        level[pin] = LOW;
+        driven[pin] = false;
+        writes[pin] = 0;
+        isr[pin] = nullptr;
+        isrMode[pin] = 0;
+    }
+}
+
+void FakeGpio::pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= HAL_PIN_COUNT) return;
+    if (mode == OUTPUT) level[pin] = LOW;
+    else if (!driven[pin]) level[pin] = HIGH;
+}
+
+void FakeGpio::digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin >= HAL_PIN_COUNT) return;
+    writes[pin]++;
+    change(pin, value ? HIGH : LOW);
+}
+
+void FakeGpio::attachInterrupt(uint8_t pin, void (*handler)(), int mode) {
+    if (pin >= HAL_PIN_COUNT) return;
+    isr[pin] = handler;
+    isrMode[pin] = mode;
+}
+
+void FakeGpio::set(uint8_t pin, uint8_t value) {
+    if (pin >= HAL_PIN_COUNT) return;
+    driven[pin] = true;
+    change(pin, value ? HIGH : LOW);
+}
+
+void FakeGpio::change(uint8_t pin, uint8_t newLevel) {
+    uint8_t old = level[pin];
+    level[pin] = newLevel;
+    if (old == newLevel || !isr[pin]) return;
+    bool rising = newLevel == HIGH;
+    if (isrMode[pin] == CHANGE || (isrMode[pin] == RISING && rising) || (isrMode[pin] == FALLING && !rising)) {
+        isr[pin]();
+    }
+}
+
+FakeServoDriver::FakeServoDriver() {
+    for (uint8_t pin = 0; pin < HAL_PIN_COUNT; pin++) angle[pin] = -1;
+}
+
+void FakeServoDriver::attach(int pin) {
+    if (pin >= 0 && pin < HAL_PIN_COUNT && angle[pin] < 0) angle[pin] = 0;
+}
+
+void FakeServoDriver::write(int pin, int value) {
+    if (pin >= 0 && pin < HAL_PIN_COUNT) angle[pin] = value;
+}
+
+HostFilesystem::HostFilesystem(const char* root) : root(root) {}
+
+String HostFilesystem::hostPath(const char* path) const {
+    return root + (path[0] == '/' ? "" : "/") + path;
+}
+
+bool HostFilesystem::begin(bool formatOnFail) {
+    struct stat st;
+    if (stat(root.c_str(), &st) == 0) return S_ISDIR(st.st_mode);
+    return formatOnFail && mkdir(root.c_str(), 0755) == 0;
+}
+
+bool HostFilesystem::format() {
+    DIR* dir = opendir(root.c_str());
+    if (!dir) return mkdir(root.c_str(), 0755) == 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_name[0] == '.') continue;
+        unlink(hostPath(entry->d_name).c_str());
+    }
+    closedir(dir);
+    return true;
+}
+
+bool HostFilesystem::exists(const char* path) {
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool HostFilesystem::remove(const char* path) {
+    return unlink(hostPath(path).c_str()) == 0;
+}
+
+File HostFilesystem::open(const char* path, const char* mode) {
+    const char* hostMode = mode[0] == 'w' ? "wb" : mode[0] == 'a' ? "ab" : "rb";
+    FILE* handle = fopen(hostPath(path).c_str(), hostMode);
+    return handle ? File(handle) : File();
+}
+
+bool FakeWiFi::mode(uint8_t mode) {
+    wifiMode = mode;
+    if (mode == WIFI_OFF) joined = false;
+    return true;
+}
+
+void FakeWiFi::begin(const char*, const char*) {
+    if (wifiMode == WIFI_OFF) wifiMode = WIFI_STA;
+    joined = reachable;
+}
+
+bool FakeWiFi::disconnect(bool wifiOff) {
+    joined = false;
+    if (wifiOff) wifiMode = WIFI_OFF;
+    return true;
+}
+
+void FakeWiFi::setReachable(bool reachable) {
+    this->reachable = reachable;
+    if (!reachable) joined = false;
+}
+
+//* BACKENDS
+HalFakes& halFakes() {
+    static HalFakes fakes;
+    static bool wired = false;
+    if (!wired) {
+        fakes.clock.attachTimer(&fakes.timer);
+        wired = true;
+    }
+    return fakes;
+}
+
+static HalClock* clockBackend = nullptr;
+static HalGpio* gpioBackend = nullptr;
+static HalTimer* timerBackend = nullptr;
+static HalServoDriver* servoBackend = nullptr;
+static HalFilesystem* fsBackend = nullptr;
+static HalWiFi* wifiBackend = nullptr;
+
+void halSetClock(HalClock* clock) { clockBackend = clock; }
+void halSetGpio(HalGpio* gpio) { gpioBackend = gpio; }
+void halSetTimer(HalTimer* timer) { timerBackend = timer; }
+void halSetServoDriver(HalServoDriver* driver) { servoBackend = driver; }
+void halSetFilesystem(HalFilesystem* fs) { fsBackend = fs; }
+void halSetWiFi(HalWiFi* wifi) { wifiBackend = wifi; }
+
+HalClock& halClock() { return clockBackend ? *clockBackend : halFakes().clock; }
+HalGpio& halGpio() { return gpioBackend ? *gpioBackend : halFakes().gpio; }
+HalTimer& halTimer() { return timerBackend ? *timerBackend : halFakes().timer; }
+HalServoDriver& halServoDriver() { return servoBackend ? *servoBackend : halFakes().servos; }
+HalFilesystem& halFS() { return fsBackend ? *fsBackend : halFakes().fs; }
+HalWiFi& halWiFi() { return wifiBackend ? *wifiBackend : halFakes().wifi; }
+
+//* SYSTEM
+bool halCleanReset() {
+    return false;
+}
+
+void halRestart() {
+    Serial.println("[hal] restart requested, exiting");
+    Serial.flush();
+    exit(0);
+}
+
+#endif // ARDUINO_ARCH_ESP32
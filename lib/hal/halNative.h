@@ -0,0 +1,200 @@
+#ifndef HAL_NATIVE_H
+#define HAL_NATIVE_H
+
+// Host side of hal.h: the same calls as halEsp32.h, dispatched to backend interfaces.
+// Everything runs on one thread; "interrupts" are plain calls made by the backends,
+// e.g. the step timer ISR runs from inside HalClock::delayUs().
+
+#include <Arduino.h>
+#include <Client.h>
+#include <FS.h>
+
+#define HAL_RETAINED // Plain static memory: a host process has no software reset
+
+//* BACKEND INTERFACES
+class HalClock {
+public:
+    virtual ~HalClock() {}
+    virtual uint64_t nowUs() = 0;
+    virtual void delayUs(uint64_t us) = 0; // Backends with timers fire them on the way
+};
+
+class HalGpio {
+public:
+    virtual ~HalGpio() {}
+    virtual void pinMode(uint8_t pin, uint8_t mode) = 0;
+    virtual void digitalWrite(uint8_t pin, uint8_t level) = 0;
+    virtual int digitalRead(uint8_t pin) = 0;
+    virtual void attachInterrupt(uint8_t pin, void (*isr)(), int mode) = 0;
+};
+
+// Step timer, same contract as HalStepTimer on the ESP32
+class HalTimer {
+public:
+    virtual ~HalTimer() {}
+    virtual void attach(void (*isr)()) = 0;
+    virtual void start(uint32_t firstUs) = 0;
+    virtual void setAlarm(uint32_t us) = 0;
+    virtual void stop() = 0;
+};
+
+class HalServoDriver {
+public:
+    virtual ~HalServoDriver() {}
+    virtual void attach(int pin) = 0;
+    virtual void write(int pin, int angle) = 0;
+};
+
+class HalFilesystem {
+public:
+    virtual ~HalFilesystem() {}
+    virtual bool begin(bool formatOnFail) = 0;
+    virtual bool format() = 0;
+    virtual bool exists(const char* path) = 0;
+    virtual bool remove(const char* path) = 0;
+    virtual File open(const char* path, const char* mode) = 0;
+};
+
+// Values as in the ESP32 WiFi library
+enum HalWiFiMode : uint8_t { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA };
+enum HalWiFiStatus : uint8_t { WL_IDLE_STATUS = 0, WL_NO_SSID_AVAIL = 1, WL_CONNECTED = 3, WL_CONNECT_FAILED = 4, WL_DISCONNECTED = 6 };
+
+// The part of the Arduino WiFi API used in lib/, plus TCP for HalNetClient/HalNetServer
+class HalWiFi {
+public:
+    virtual ~HalWiFi() {}
+    virtual bool mode(uint8_t mode) = 0;
+    virtual void begin(const char* ssid, const char* pass) = 0;
+    virtual bool disconnect(bool wifiOff = false) = 0;
+    virtual uint8_t status() = 0;
+    virtual IPAddress localIP() = 0;
+    virtual String macAddress() = 0;
+    virtual bool softAPConfig(IPAddress ip, IPAddress gateway, IPAddress subnet) = 0;
+    virtual bool softAP(const char* ssid) = 0;
+    virtual IPAddress softAPIP() = 0;
+    virtual int16_t scanNetworks() = 0;
+    virtual String SSID(uint8_t i) = 0;
+    virtual int32_t RSSI(uint8_t i) = 0;
+
+    // Outgoing / accepted connection, owned by the backend until stop(); nullptr = refused / none
+    virtual Client* openConnection(IPAddress ip, uint16_t port) = 0;
+    virtual Client* acceptConnection(uint16_t port) = 0;
+};
+
+// Backends in use, the fakes from halFakes.h until replaced
+void halSetClock(HalClock* clock);
+void halSetGpio(HalGpio* gpio);
+void halSetTimer(HalTimer* timer);
+void halSetServoDriver(HalServoDriver* driver);
+void halSetFilesystem(HalFilesystem* fs);
+void halSetWiFi(HalWiFi* wifi);
+
+HalClock& halClock();
+HalGpio& halGpio();
+HalTimer& halTimer();
+HalServoDriver& halServoDriver();
+HalFilesystem& halFS();
+HalWiFi& halWiFi();
+
+//* TIME
+static inline unsigned long halMillis() { return halClock().nowUs() / 1000; }
+static inline unsigned long halMicros() { return halClock().nowUs(); }
+static inline void halDelay(unsigned long ms) { halClock().delayUs((uint64_t)ms * 1000); }
+static inline int64_t halTimeUs() { return halClock().nowUs(); }
+static inline void halStartTimeSync(const char*) {} // The host clock is already set
+
+//* GPIO
+static inline void halPinMode(uint8_t pin, uint8_t mode) { halGpio().pinMode(pin, mode); }
+static inline void halDigitalWrite(uint8_t pin, uint8_t level) { halGpio().digitalWrite(pin, level); }
+static inline int halDigitalRead(uint8_t pin) { return halGpio().digitalRead(pin); }
+static inline void halAttachInterrupt(uint8_t pin, void (*isr)(), int mode) { halGpio().attachInterrupt(pin, isr, mode); }
+
+//* STEP TIMER
+class HalStepTimer {
+public:
+    HalStepTimer() : ready(false) {}
+    void begin(uint8_t, void (*isr)()) {
+        halTimer().attach(isr);
+        ready = true;
+    }
+    bool isReady() const { return ready; }
+    void start(uint32_t firstUs) { halTimer().start(firstUs); }
+    void setAlarm(uint32_t us) { halTimer().setAlarm(us); }
+    void stop() { halTimer().stop(); }
+
+private:
+    bool ready;
+};
+
+//* SERVO PWM
+class HalServo {
+public:
+    HalServo() : pin(-1), angle(0) {}
+    int attach(int pin) {
+        this->pin = pin;
+        halServoDriver().attach(pin);
+        return pin;
+    }
+    void write(int angle) {
+        this->angle = angle;
+        if (pin >= 0) halServoDriver().write(pin, angle);
+    }
+    int read() const { return angle; }
+
+private:
+    int pin;
+    int angle;
+};
+
+//* NETWORK
+// TCP connection through HalWiFi, usable wherever the firmware passes a WiFiClient
+class HalNetClient : public Client {
+public:
+    HalNetClient() : conn(nullptr) {}
+    explicit HalNetClient(Client* conn) : conn(conn) {}
+
+    int connect(IPAddress ip, uint16_t port) override {
+        stop();
+        conn = halWiFi().openConnection(ip, port);
+        return conn != nullptr;
+    }
+    int connect(const char*, uint16_t) override { return 0; } // No DNS on the host
+    size_t write(uint8_t b) override { return conn ? conn->write(b) : 0; }
+    size_t write(const uint8_t* buf, size_t size) override { return conn ? conn->write(buf, size) : 0; }
+    int available() override { return conn ? conn->available() : 0; }
+    int read() override { return conn ? conn->read() : -1; }
+    int read(uint8_t* buf, size_t size) override { return conn ? conn->read(buf, size) : -1; }
+    int peek() override { return conn ? conn->peek() : -1; }
+    void flush() override {}
+    void stop() override {
+        if (conn) conn->stop();
+        conn = nullptr;
+    }
+    uint8_t connected() override { return conn && conn->connected(); }
+    operator bool() override { return conn != nullptr; }
+
+private:
+    Client* conn;
+};
+
+class HalNetServer {
+public:
+    explicit HalNetServer(uint16_t port) : port(port) {}
+    void begin() {}
+    HalNetClient available() { return HalNetClient(halWiFi().acceptConnection(port)); }
+
+private:
+    uint16_t port;
+};
+
+class HalDnsServer { // Captive portal DNS: nothing to answer on the host
+public:
+    bool start(uint16_t, const char*, IPAddress) { return true; }
+    void processNextRequest() {}
+};
+
+//* SYSTEM
+bool halCleanReset();   // Always false: there is no retained RAM to trust
+void halRestart();      // Ends the process
+
+#endif // HAL_NATIVE_H
@@ -0,0 +1,82 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Minimal Arduino core for env:native. Only on the include path of that environment
+// (-I lib/hal/native); time and pins go through the HAL backends, so third-party
+// code calling millis() or delay() runs in the same (virtual) time as lib/.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <cmath>
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define IRAM_ATTR
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+
+using std::isinf;
+using std::isnan;
+using std::max;
+using std::min;
+
+template <typename T, typename L, typename H>
+static inline T constrain(T value, L low, H high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+#define HOST_NEEDS_STRLCPY 1
+extern "C" size_t strlcpy(char* dst, const char* src, size_t size);
+#endif
+
+// stdout, line by line; read() takes what hostSerialFeed() queued
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override;
+};
+
+extern HardwareSerial Serial;
+void hostSerialFeed(const char* input);
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,33 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <stdio.h>
+#include <memory>
+#include "Stream.h"
+
+// Open file as returned by halFS().open(). Copies share the handle, like fs::File.
+class File : public Stream {
+public:
+    File() {}
+    explicit File(FILE* handle) : handle(handle, fclose) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t read(uint8_t* buffer, size_t size);
+    void flush() override;
+
+    bool seek(uint32_t pos);
+    size_t position() const;
+    size_t size() const;
+    void close() { handle.reset(); }
+    operator bool() const { return handle != nullptr; }
+
+private:
+    std::shared_ptr<FILE> handle;
+};
+
+#endif // HOST_FS_H
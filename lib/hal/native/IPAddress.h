@@ -0,0 +1,24 @@
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include <stdint.h>
+#include "Print.h"
+
+class IPAddress : public Printable {
+public:
+    IPAddress() : value(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : value(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+    IPAddress(uint32_t address) : value(address) {}
+
+    operator uint32_t() const { return value; }
+    uint8_t operator[](int index) const { return (value >> (8 * index)) & 0xFF; }
+    bool operator==(const IPAddress& other) const { return value == other.value; }
+
+    String toString() const;
+    size_t printTo(Print& p) const override { return p.print(toString()); }
+
+private:
+    uint32_t value; // First octet in the low byte, as on the ESP32
+};
+
+#endif // HOST_IPADDRESS_H
@@ -0,0 +1,28 @@
+#ifndef HOST_STREAM_H
+#define HOST_STREAM_H
+
+#include "Print.h"
+
+// Arduino Stream: reads give up after the timeout in host (virtual) time
+class Stream : public Print {
+public:
+    Stream() : timeoutMs(1000) {}
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { timeoutMs = timeout; }
+    unsigned long getTimeout() const { return timeoutMs; }
+
+    size_t readBytes(char* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+    String readStringUntil(char terminator);
+    String readString();
+
+protected:
+    unsigned long timeoutMs;
+
+    int timedRead();
+};
+
+#endif // HOST_STREAM_H
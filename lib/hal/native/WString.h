@@ -0,0 +1,98 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Arduino String for the host build, backed by std::string. Covers the part of the
+// API used in lib/ and by ArduinoJson (ARDUINOJSON_ENABLE_ARDUINO_STRING).
+class StringSumHelper;
+
+class String {
+public:
+    String() {}
+    String(const char* cstr) : s(cstr ? cstr : "") {}
+    String(const String& other) : s(other.s) {}
+    explicit String(const std::string& str) : s(str) {}
+    explicit String(char c) : s(1, c) {}
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10);
+    explicit String(unsigned long long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimalPlaces = 2);
+    explicit String(double value, unsigned int decimalPlaces = 2);
+
+    String& operator=(const String& other) { s = other.s; return *this; }
+    String& operator=(const char* cstr) { s = cstr ? cstr : ""; return *this; }
+
+    const char* c_str() const { return s.c_str(); }
+    unsigned int length() const { return s.size(); }
+    bool isEmpty() const { return s.empty(); }
+    bool reserve(unsigned int size) { s.reserve(size); return true; }
+
+    bool concat(const String& str) { s += str.s; return true; }
+    bool concat(const char* cstr) { if (cstr) s += cstr; return cstr != nullptr; }
+    bool concat(const char* cstr, unsigned int length) { if (cstr) s.append(cstr, length); return cstr != nullptr; }
+    bool concat(char c) { s += c; return true; }
+    template <typename T> bool concat(T value) { return concat(String(value)); }
+
+    String& operator+=(const String& rhs) { concat(rhs); return *this; }
+    String& operator+=(const char* cstr) { concat(cstr); return *this; }
+    String& operator+=(char c) { concat(c); return *this; }
+    template <typename T> String& operator+=(T value) { concat(String(value)); return *this; }
+
+    bool equals(const String& other) const { return s == other.s; }
+    bool equals(const char* cstr) const { return s == (cstr ? cstr : ""); }
+    bool operator==(const String& rhs) const { return equals(rhs); }
+    bool operator==(const char* cstr) const { return equals(cstr); }
+    bool operator!=(const String& rhs) const { return !equals(rhs); }
+    bool operator!=(const char* cstr) const { return !equals(cstr); }
+    bool operator<(const String& rhs) const { return s < rhs.s; }
+
+    char operator[](unsigned int index) const { return index < s.size() ? s[index] : 0; }
+    char& operator[](unsigned int index) { return s[index]; }
+    char charAt(unsigned int index) const { return (*this)[index]; }
+
+    bool startsWith(const String& prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+    bool endsWith(const String& suffix) const {
+        return s.size() >= suffix.s.size() && s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+    }
+    int indexOf(char c, unsigned int from = 0) const { return position(s.find(c, from)); }
+    int indexOf(const String& str, unsigned int from = 0) const { return position(s.find(str.s, from)); }
+    int lastIndexOf(char c) const { return position(s.rfind(c)); }
+    String substring(unsigned int from) const { return from < s.size() ? String(s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const;
+
+    void trim();
+    void toLowerCase();
+    void toUpperCase();
+    void replace(const String& find, const String& replacement);
+    void remove(unsigned int index, unsigned int count = (unsigned int)-1) { if (index < s.size()) s.erase(index, count); }
+
+    long toInt() const;
+    float toFloat() const;
+
+private:
+    std::string s;
+
+    static int position(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+};
+
+// Result of a concatenation, as in the Arduino core (ArduinoJson adapts both types)
+class StringSumHelper : public String {
+public:
+    StringSumHelper(const String& str) : String(str) {}
+    StringSumHelper(const char* cstr) : String(cstr) {}
+};
+
+StringSumHelper operator+(const String& lhs, const String& rhs);
+StringSumHelper operator+(const String& lhs, const char* rhs);
+StringSumHelper operator+(const char* lhs, const String& rhs);
+StringSumHelper operator+(const String& lhs, char rhs);
+template <typename T> StringSumHelper operator+(const String& lhs, T rhs) { return lhs + String(rhs); }
+
+#endif // HOST_WSTRING_H
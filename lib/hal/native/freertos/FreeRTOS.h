@@ -0,0 +1,20 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// Single-threaded stand-in for the FreeRTOS calls used here. Nothing ever blocks:
+// a queue receive with a timeout returns at once, a delay advances the HAL clock.
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#endif // HOST_FREERTOS_H
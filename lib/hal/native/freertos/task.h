@@ -0,0 +1,16 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+// There are no tasks on the host: the native entry point calls the task bodies from
+// one loop. A handle from hostTaskCreate() only counts the notifications sent to it.
+typedef struct HostTask* TaskHandle_t;
+
+TaskHandle_t hostTaskCreate();
+uint32_t hostTaskNotifyTake(TaskHandle_t task); // Pending notifications, cleared
+
+void xTaskNotifyGive(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+
+#endif // HOST_FREERTOS_TASK_H
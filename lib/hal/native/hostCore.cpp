@@ -0,0 +1,343 @@
+#ifndef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+#include <FS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "../hal.h"
+
+//* STRING
+static std::string formatInteger(unsigned long long value, bool negative, unsigned char base) {
+    if (base < 2 || base > 36) base = 10;
+    char buffer[66];
+    char* p = buffer + sizeof(buffer);
+    *--p = 0;
+    do {
+        unsigned digit = value % base;
+        *--p = digit < 10 ? '0' + digit : 'a' + digit - 10;
+        value /= base;
+    } while (value);
+    if (negative) *--p = '-';
+    return std::string(p);
+}
+
+static std::string formatSigned(long long value, unsigned char base) {
+    if (value < 0 && base == 10) return formatInteger(0ULL - (unsigned long long)value, true, base);
+    return formatInteger((unsigned long long)value, false, base);
+}
+
+static std::string formatFloat(double value, unsigned int decimalPlaces) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", (int)decimalPlaces, value);
+    return std::string(buffer);
+}
+
+String::String(unsigned char value, unsigned char base) : s(formatInteger(value, false, base)) {}
+String::String(int value, unsigned char base) : s(formatSigned(value, base)) {}
+String::String(unsigned int value, unsigned char base) : s(formatInteger(value, false, base)) {}
+String::String(long value, unsigned char base) : s(formatSigned(value, base)) {}
+String::String(unsigned long value, unsigned char base) : s(formatInteger(value, false, base)) {}
+String::String(long long value, unsigned char base) : s(formatSigned(value, base)) {}
+String::String(unsigned long long value, unsigned char base) : s(formatInteger(value, false, base)) {}
+String::String(float value, unsigned int decimalPlaces) : s(formatFloat(value, decimalPlaces)) {}
+String::String(double value, unsigned int decimalPlaces) : s(formatFloat(value, decimalPlaces)) {}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= s.size()) return String();
+    return String(s.substr(from, to - from));
+}
+
+void String::trim() {
+    size_t begin = 0, end = s.size();
+    while (begin < end && isspace((unsigned char)s[begin])) begin++;
+    while (end > begin && isspace((unsigned char)s[end - 1])) end--;
+    s = s.substr(begin, end - begin);
+}
+
+void String::toLowerCase() {
+    for (size_t i = 0; i < s.size(); i++) s[i] = tolower((unsigned char)s[i]);
+}
+
+void String::toUpperCase() {
+    for (size_t i = 0; i < s.size(); i++) s[i] = toupper((unsigned char)s[i]);
+}
+
+void String::replace(const String& find, const String& replacement) {
+    if (find.s.empty()) return;
+    size_t pos = 0;
+    while ((pos = s.find(find.s, pos)) != std::string::npos) {
+        s.replace(pos, find.s.size(), replacement.s);
+        pos += replacement.s.size();
+    }
+}
+
+long String::toInt() const { return strtol(s.c_str(), nullptr, 10); }
+float String::toFloat() const { return strtof(s.c_str(), nullptr); }
+
+StringSumHelper operator+(const String& lhs, const String& rhs) {
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+StringSumHelper operator+(const String& lhs, const char* rhs) { return lhs + String(rhs); }
+StringSumHelper operator+(const char* lhs, const String& rhs) { return String(lhs) + rhs; }
+StringSumHelper operator+(const String& lhs, char rhs) { return lhs + String(rhs); }
+
+//* PRINT / STREAM
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+}
+
+size_t Print::write(const char* str) {
+    return str ? write((const uint8_t*)str, strlen(str)) : 0;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char small[128];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+    if (length < 0) return 0;
+    if ((size_t)length < sizeof(small)) return write((const uint8_t*)small, length);
+
+    std::vector<char> large(length + 1);
+    va_start(args, format);
+    vsnprintf(large.data(), large.size(), format, args);
+    va_end(args);
+    return write((const uint8_t*)large.data(), length);
+}
+
+size_t Print::print(long value, int base) { return print(String(value, (unsigned char)base)); }
+size_t Print::print(unsigned long value, int base) { return print(String(value, (unsigned char)base)); }
+size_t Print::print(long long value, int base) { return print(String(value, (unsigned char)base)); }
+size_t Print::print(unsigned long long value, int base) { return print(String(value, (unsigned char)base)); }
+size_t Print::print(double value, int digits) { return print(String(value, (unsigned int)digits)); }
+
+int Stream::timedRead() {
+    unsigned long start = millis();
+    do {
+        int c = read();
+        if (c >= 0) return c;
+        delay(1);
+    } while (millis() - start < timeoutMs);
+    return -1;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+        int c = timedRead();
+        if (c < 0) break;
+        buffer[count++] = (char)c;
+    }
+    return count;
+}
+
+String Stream::readStringUntil(char terminator) {
+    String result;
+    int c = timedRead();
+    while (c >= 0 && c != terminator) {
+        result += (char)c;
+        c = timedRead();
+    }
+    return result;
+}
+
+String Stream::readString() {
+    String result;
+    int c = timedRead();
+    while (c >= 0) {
+        result += (char)c;
+        c = timedRead();
+    }
+    return result;
+}
+
+String IPAddress::toString() const {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buffer);
+}
+
+//* SERIAL
+HardwareSerial Serial;
+static std::deque<uint8_t> serialInput;
+
+size_t HardwareSerial::write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) { return fwrite(buffer, 1, size, stdout); }
+int HardwareSerial::available() { return serialInput.size(); }
+int HardwareSerial::read() {
+    if (serialInput.empty()) return -1;
+    uint8_t c = serialInput.front();
+    serialInput.pop_front();
+    return c;
+}
+int HardwareSerial::peek() { return serialInput.empty() ? -1 : serialInput.front(); }
+void HardwareSerial::flush() { fflush(stdout); }
+
+void hostSerialFeed(const char* input) {
+    while (*input) serialInput.push_back((uint8_t)*input++);
+}
+
+//* FILE
+size_t File::write(const uint8_t* buffer, size_t size) {
+    return handle ? fwrite(buffer, 1, size, handle.get()) : 0;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    return handle ? fread(buffer, 1, size, handle.get()) : 0;
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+    if (!handle) return -1;
+    int c = fgetc(handle.get());
+    if (c != EOF) ungetc(c, handle.get());
+    return c == EOF ? -1 : c;
+}
+
+int File::available() {
+    return handle ? (int)(size() - position()) : 0;
+}
+
+void File::flush() {
+    if (handle) fflush(handle.get());
+}
+
+bool File::seek(uint32_t pos) {
+    return handle && fseek(handle.get(), pos, SEEK_SET) == 0;
+}
+
+size_t File::position() const {
+    return handle ? ftell(handle.get()) : 0;
+}
+
+size_t File::size() const {
+    if (!handle) return 0;
+    long pos = ftell(handle.get());
+    fseek(handle.get(), 0, SEEK_END);
+    long end = ftell(handle.get());
+    fseek(handle.get(), pos, SEEK_SET);
+    return end;
+}
+
+//* TIME / RANDOM
+unsigned long millis() { return halMillis(); }
+unsigned long micros() { return halMicros(); }
+void delay(unsigned long ms) { halDelay(ms); }
+void delayMicroseconds(unsigned int us) { halClock().delayUs(us); }
+void yield() {}
+
+long random(long max) { return max > 0 ? ::random() % max : 0; }
+long random(long min, long max) { return max > min ? min + random(max - min) : min; }
+void randomSeed(unsigned long seed) { srandom(seed); }
+
+#ifdef HOST_NEEDS_STRLCPY
+extern "C" size_t strlcpy(char* dst, const char* src, size_t size) {
+    size_t length = strlen(src);
+    if (size) {
+        size_t n = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = 0;
+    }
+    return length;
+}
+#endif
+
+//* FREERTOS
+struct HostQueue {
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    std::deque<std::vector<uint8_t> > items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    HostQueue* queue = new HostQueue;
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t) {
+    if (!queue || queue->items.size() >= queue->length) return pdFALSE;
+    const uint8_t* bytes = (const uint8_t*)item;
+    queue->items.push_back(std::vector<uint8_t>(bytes, bytes + queue->itemSize));
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t) {
+    if (!queue || queue->items.empty()) return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    return queue ? queue->items.size() : 0;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+struct HostMutex {
+    uint32_t depth;
+};
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    HostMutex* mutex = new HostMutex;
+    mutex->depth = 0;
+    return mutex;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t) {
+    if (!mutex) return pdFALSE;
+    mutex->depth++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex) {
+    if (!mutex || mutex->depth == 0) return pdFALSE;
+    mutex->depth--;
+    return pdTRUE;
+}
+
+struct HostTask {
+    uint32_t notifications;
+};
+
+TaskHandle_t hostTaskCreate() {
+    HostTask* task = new HostTask;
+    task->notifications = 0;
+    return task;
+}
+
+uint32_t hostTaskNotifyTake(TaskHandle_t task) {
+    uint32_t count = task->notifications;
+    task->notifications = 0;
+    return count;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+    if (task) task->notifications++;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    halDelay(ticks * portTICK_PERIOD_MS);
+}
+
+#endif // ARDUINO_ARCH_ESP32
@@ -0,0 +1,234 @@
+#ifndef ARDUINO_ARCH_ESP32
+
+#include "keypadSimulator.h"
+
+static const int servoPins[SERVO_COUNT] = {SERVO_LEFT_PIN, SERVO_MIDDLE_PIN, SERVO_RIGHT_PIN};
+static const uint32_t MOVE_GAP_US = 20000; // Longer gaps between step edges separate two moves
+static const uint8_t NO_KEY = 0xFF;
+
+KeypadSimulator::Config KeypadSimulator::defaultConfig() {
+    Config config = {};
+    config.topSwitchMm = SIM_TOP_SWITCH_MM;
+    config.switchHysteresisMm = SIM_SWITCH_HYSTERESIS_MM;
+    config.railLengthMm = SIM_RAIL_LENGTH_MM;
+    config.startMm = SIM_START_MM;
+    for (uint8_t line = 0; line < 4; line++) config.lineMm[line] = SIM_FIRST_LINE_MM + line * SIM_LINE_PITCH_MM;
+    config.keyToleranceMm = SIM_KEY_TOLERANCE_MM;
+    config.maxStepRate = SIM_MAX_STEP_RATE;
+    config.servoDegPerMs = SIM_SERVO_DEG_PER_MS;
+    config.contactAngle = SIM_CONTACT_ANGLE;
+    config.clearAngle = SIM_CLEAR_ANGLE;
+    config.registerMs = SIM_REGISTER_MS;
+    config.layout = DEFAULT_KEYPAD_LAYOUT;
+    return config;
+}
+
+KeypadSimulator::KeypadSimulator(const Config& config)
+    : config(config), carriage(railMmToSteps(config.startMm)), switchTrip(railMmToSteps(config.topSwitchMm)),
+    switchRelease(railMmToSteps(config.topSwitchMm + config.switchHysteresisMm)),
+    railEnd(railMmToSteps(config.railLengthMm)), switchClosed(false), lastEdgeUs(0), maxRate(0),
+    totalTravelSteps(0), lostSteps(0), collisions(0), missedPresses(0), keyCount(0), running(false),
+    runStartUs(0), runEndUs(0), lastKeyUs(0), runTravelSteps(0), spanMoveUs(0), spanSteps(0) {
+    minEdgeUs = config.maxStepRate ? 1000000UL / config.maxStepRate : 0;
+    for (uint8_t i = 0; i < SERVO_COUNT; i++) {
+        Plunger& p = plungers[i];
+        p.pin = servoPins[i];
+        p.fromAngle = 0;
+        p.target = 0;
+        p.commandUs = 0;
+        p.pressCommandUs = 0;
+        p.inContact = false;
+        p.registered = false;
+        p.contactUs = 0;
+        p.releaseUs = UINT64_MAX;
+        p.contactCarriage = 0;
+    }
+}
+
+void KeypadSimulator::install() {
+    halSetGpio(this);
+    halSetServoDriver(this);
+    switchClosed = carriage <= switchTrip;
+    set(LIMIT_PIN_TOP, switchClosed ? LOW : HIGH);
+}
+
+float KeypadSimulator::homeMm() const {
+    return stepsToRailMm(switchTrip + CLEARANCE_STEPS);
+}
+
+//* STEPPER AND CARRIAGE
+void KeypadSimulator::digitalWrite(uint8_t pin, uint8_t value) {
+    bool rising = pin == STEP_PIN && value == HIGH && level[STEP_PIN] == LOW;
+    FakeGpio::digitalWrite(pin, value);
+    if (rising) step();
+}
+
+void KeypadSimulator::step() {
+    uint64_t now = halClock().nowUs();
+    uint64_t interval = lastEdgeUs ? now - lastEdgeUs : MOVE_GAP_US;
+    lastEdgeUs = now;
+
+    if (level[ENABLE_PIN] == HIGH || interval < minEdgeUs) {
+        lostSteps++; // Driver off, or faster than the motor can follow
+        return;
+    }
+    if (interval < MOVE_GAP_US) {
+        spanMoveUs += interval;
+        uint32_t rate = 1000000UL / (interval ? interval : 1);
+        if (rate > maxRate) maxRate = rate;
+    }
+
+    advance(now);
+    for (uint8_t i = 0; i < SERVO_COUNT; i++) {
+        if (angleAt(plungers[i], now) > config.clearAngle) collisions++;
+    }
+
+    long next = carriage + (level[DIR_PIN] == HIGH ? 1 : -1);
+    if (next < 0 || next > railEnd) {
+        lostSteps++; // Against an end stop
+        return;
+    }
+    carriage = next;
+    totalTravelSteps++;
+    runTravelSteps++;
+    spanSteps++;
+    updateSwitch();
+}
+
+void KeypadSimulator::updateSwitch() {
+    bool closed = switchClosed ? carriage <= switchRelease : carriage <= switchTrip;
+    if (closed == switchClosed) return;
+    switchClosed = closed;
+    set(LIMIT_PIN_TOP, closed ? LOW : HIGH); // Runs the firmware's limit interrupt on closing
+}
+
+//* SERVO PLUNGERS
+void KeypadSimulator::attach(int pin) {
+    Plunger* p = plungerOnPin(pin);
+    if (p) p->commandUs = halClock().nowUs();
+}
+
+void KeypadSimulator::write(int pin, int angle) {
+    Plunger* p = plungerOnPin(pin);
+    if (!p) return;
+    uint64_t now = halClock().nowUs();
+    advance(now);
+    p->fromAngle = angleAt(*p, now);
+    p->target = angle;
+    p->commandUs = now;
+    if (angle >= config.contactAngle && p->fromAngle < config.contactAngle) p->pressCommandUs = now;
+}
+
+KeypadSimulator::Plunger* KeypadSimulator::plungerOnPin(int pin) {
+    for (uint8_t i = 0; i < SERVO_COUNT; i++) {
+        if (plungers[i].pin == pin) return &plungers[i];
+    }
+    return nullptr;
+}
+
+// Constant angular speed from the angle at the last command towards its target
+float KeypadSimulator::angleAt(const Plunger& p, uint64_t us) const {
+    float travel = config.servoDegPerMs * (us - p.commandUs) / 1000.0f;
+    float distance = p.target - p.fromAngle;
+    if (travel >= fabsf(distance)) return p.target;
+    return p.fromAngle + (distance > 0 ? travel : -travel);
+}
+
+// Between two commands a plunger moves one way, so it crosses the contact angle at most once
+void KeypadSimulator::trackContact(Plunger& p, uint64_t until) {
+    float contact = config.contactAngle;
+    float speedUs = config.servoDegPerMs / 1000.0f;
+    if (!p.inContact && p.fromAngle < contact && p.target >= contact) {
+        uint64_t at = p.commandUs + (uint64_t)((contact - p.fromAngle) / speedUs);
+        if (at > until) return;
+        p.inContact = true;
+        p.registered = false;
+        p.contactUs = at;
+        p.releaseUs = UINT64_MAX;
+        p.contactCarriage = carriage;
+    } else if (p.inContact && p.releaseUs == UINT64_MAX && p.fromAngle >= contact && p.target < contact) {
+        uint64_t at = p.commandUs + (uint64_t)((p.fromAngle - contact) / speedUs);
+        if (at <= until) p.releaseUs = at;
+    }
+}
+
+// Brings the plungers up to `until`. Keys are registered oldest first, so they are
+// recorded in the order the keypad saw them even when presses overlap
+void KeypadSimulator::advance(uint64_t until) {
+    for (uint8_t i = 0; i < SERVO_COUNT; i++) trackContact(plungers[i], until);
+
+    uint64_t registerUs = config.registerMs * 1000ULL;
+    for (;;) {
+        Plunger* next = nullptr;
+        for (uint8_t i = 0; i < SERVO_COUNT; i++) {
+            Plunger& p = plungers[i];
+            uint64_t at = p.contactUs + registerUs;
+            if (!p.inContact || p.registered || at > until || at > p.releaseUs) continue;
+            if (!next || at < next->contactUs + registerUs) next = &p;
+        }
+        if (!next) break;
+        registerKey(*next, next->contactUs + registerUs);
+    }
+
+    for (uint8_t i = 0; i < SERVO_COUNT; i++) {
+        Plunger& p = plungers[i];
+        if (!p.inContact || p.releaseUs > until) continue;
+        if (!p.registered) missedPresses++; // Let go before the keypad registered it
+        p.inContact = false;
+    }
+}
+
+void KeypadSimulator::registerKey(Plunger& p, uint64_t atUs) {
+    p.registered = true;
+    uint8_t servo = (&p - plungers) + 1;
+    uint8_t line = 0;
+    uint8_t button = keyAt(p.contactCarriage, servo, line);
+    if (button == NO_KEY) missedPresses++;
+    if (!running || keyCount >= SIM_MAX_KEYS) return;
+
+    KeyEvent& key = keys[keyCount++];
+    key.button = button;
+    key.line = line;
+    key.servo = servo;
+    key.atUs = atUs;
+    key.spanUs = atUs - lastKeyUs;
+    key.moveUs = spanMoveUs;
+    key.travelSteps = spanSteps;
+    key.pressUs = atUs - p.pressCommandUs;
+    lastKeyUs = atUs;
+    spanMoveUs = 0;
+    spanSteps = 0;
+}
+
+uint8_t KeypadSimulator::keyAt(long position, uint8_t servo, uint8_t& line) const {
+    float mm = stepsToRailMm(position);
+    for (uint8_t l = 1; l <= KEYPAD_MAX_LINES; l++) {
+        float lineMm = config.lineMm[l - 1];
+        if (lineMm <= 0 || fabsf(mm - lineMm) > config.keyToleranceMm) continue;
+        line = l;
+        for (uint8_t b = 0; b < config.layout.buttonCount; b++) {
+            if (config.layout.keys[b].line == l && config.layout.keys[b].servo == servo) return b;
+        }
+    }
+    return NO_KEY;
+}
+
+//* RUNS
+void KeypadSimulator::beginRun() {
+    uint64_t now = halClock().nowUs();
+    keyCount = 0;
+    running = true;
+    runStartUs = runEndUs = lastKeyUs = now;
+    runTravelSteps = 0;
+    spanMoveUs = 0;
+    spanSteps = 0;
+}
+
+void KeypadSimulator::endRun() {
+    uint64_t now = halClock().nowUs();
+    advance(now);
+    running = false;
+    runEndUs = now;
+}
+
+#endif // ARDUINO_ARCH_ESP32
@@ -0,0 +1,178 @@
+#ifndef KEYPAD_SIMULATOR_H
+#define KEYPAD_SIMULATOR_H
+
+#include <Arduino.h>
+#include "halFakes.h"
+#include "keypadLayout.h"
+#include "motorConfig.h"
+
+// Defaults for KeypadSimulator::Config (override with -D): a 4-line meter keypad on a 120 mm rail
+#ifndef SIM_TOP_SWITCH_MM
+#define SIM_TOP_SWITCH_MM 5.0       // Rail position (mm below the top end stop) where the top switch closes
+#endif
+#ifndef SIM_SWITCH_HYSTERESIS_MM
+#define SIM_SWITCH_HYSTERESIS_MM 0.3 // Carriage travel past the trip point before the switch opens again
+#endif
+#ifndef SIM_RAIL_LENGTH_MM
+#define SIM_RAIL_LENGTH_MM 120.0    // Bottom end stop
+#endif
+#ifndef SIM_START_MM
+#define SIM_START_MM 60.0           // Carriage position at power-up
+#endif
+#ifndef SIM_LINE_PITCH_MM
+#define SIM_LINE_PITCH_MM 15.0      // Keypad lines, the first one SIM_FIRST_LINE_MM down the rail
+#endif
+#ifndef SIM_FIRST_LINE_MM
+#define SIM_FIRST_LINE_MM 25.0
+#endif
+#ifndef SIM_KEY_TOLERANCE_MM
+#define SIM_KEY_TOLERANCE_MM 1.5    // A plunger this far off the line still hits the key
+#endif
+#ifndef SIM_MAX_STEP_RATE
+#define SIM_MAX_STEP_RATE 4000      // steps/s the motor follows, faster pulses are lost
+#endif
+#ifndef SIM_SERVO_DEG_PER_MS
+#define SIM_SERVO_DEG_PER_MS 0.3    // Loaded hobby servo (about 0.2 s per 60 degrees)
+#endif
+#ifndef SIM_CONTACT_ANGLE
+#define SIM_CONTACT_ANGLE 18        // Plunger touches the key at this servo angle
+#endif
+#ifndef SIM_CLEAR_ANGLE
+#define SIM_CLEAR_ANGLE 8           // Below this the plunger is above the keys, the carriage may move
+#endif
+#ifndef SIM_REGISTER_MS
+#define SIM_REGISTER_MS 40          // Contact time the keypad needs to register a key
+#endif
+
+#define SIM_MAX_KEYS 64             // Key events kept per run (a token is at most ~30)
+
+// Simulated rig behind the HAL: stepper and carriage on the GPIO backend, the servo
+// plungers on the servo backend, everything in the virtual time of halFakes().clock.
+//
+// The carriage moves one step per rising edge on STEP_PIN (direction from DIR_PIN,
+// only while ENABLE_PIN is LOW), stops at the rail end stops and loses pulses that
+// come faster than the motor follows. The top switch on LIMIT_PIN_TOP closes at a
+// configurable rail position and fires the pin's interrupt like the real one.
+// Each plunger swings at a fixed angular speed towards its last written angle; a key
+// registers when a plunger stays past the contact angle for the register time with
+// the carriage on a keypad line. Steps while a plunger is below the clear angle are
+// counted as collisions.
+//
+// Between beginRun() and endRun() every registered key is recorded with the time,
+// travel and motion it took since the key before it.
+class KeypadSimulator : public FakeGpio, public HalServoDriver {
+public:
+    struct Config {
+        float topSwitchMm;
+        float switchHysteresisMm;
+        float railLengthMm;
+        float startMm;
+        float lineMm[KEYPAD_MAX_LINES]; // Rail position of line 1.., 0 = no such line
+        float keyToleranceMm;
+        uint32_t maxStepRate;
+        float servoDegPerMs;
+        uint8_t contactAngle;
+        uint8_t clearAngle;
+        uint16_t registerMs;
+        KeypadLayout layout;            // Which key sits under which servo on which line
+    };
+
+    // One registered key
+    struct KeyEvent {
+        uint8_t button;       // Index into the layout, 0xFF = no key under the plunger
+        uint8_t line;
+        uint8_t servo;
+        uint64_t atUs;        // Registered (contact + register time)
+        uint32_t spanUs;      // Since the previous key (or beginRun)
+        uint32_t moveUs;      // Of the span, time the carriage was stepping
+        uint32_t travelSteps; // Of the span, steps taken in either direction
+        uint32_t pressUs;     // From the servo command to registration
+    };
+
+    static Config defaultConfig();
+
+    explicit KeypadSimulator(const Config& config = defaultConfig());
+    void install(); // Becomes the GPIO and servo backend
+
+    // GPIO backend
+    void digitalWrite(uint8_t pin, uint8_t value) override;
+
+    // Servo backend
+    void attach(int pin) override;
+    void write(int pin, int angle) override;
+
+    // Line coordinates (mm from home) the firmware needs for this rig: homing stops
+    // CLEARANCE_STEPS below the switch trip point
+    float homeMm() const;
+    float lineCoordinate(uint8_t line) const { return config.lineMm[line - 1] - homeMm(); }
+    float maxPosition() const { return config.railLengthMm - homeMm() - 1.0f; }
+
+    void beginRun();
+    void endRun();
+    uint8_t getKeyCount() const { return keyCount; }
+    const KeyEvent& getKey(uint8_t i) const { return keys[i]; }
+    uint64_t getRunUs() const { return runEndUs - runStartUs; }
+    uint64_t getTailUs() const { return runEndUs - lastKeyUs; } // After the last key: return move, replies
+
+    float getCarriageMm() const { return stepsToRailMm(carriage); }
+    bool isSwitchClosed() const { return switchClosed; }
+    uint32_t getRunTravelSteps() const { return runTravelSteps; }
+    uint32_t getTotalTravelSteps() const { return totalTravelSteps; }
+    uint32_t getLostSteps() const { return lostSteps; }
+    uint32_t getCollisions() const { return collisions; }
+    uint32_t getMissedPresses() const { return missedPresses; } // Contact too short, or no key under the plunger
+    uint32_t getMaxStepRate() const { return maxRate; }
+
+private:
+    struct Plunger {
+        int pin;
+        float fromAngle;      // Angle when the last command was written
+        int target;
+        uint64_t commandUs;
+        uint64_t pressCommandUs; // Last command that swung the plunger onto the key
+        bool inContact;
+        bool registered;
+        uint64_t contactUs;
+        uint64_t releaseUs;      // UINT64_MAX while the plunger stays on the key
+        long contactCarriage;
+    };
+
+    Config config;
+    long carriage;           // Steps down the rail from the top end stop
+    long switchTrip;
+    long switchRelease;
+    long railEnd;
+    bool switchClosed;
+    uint64_t lastEdgeUs;
+    uint32_t minEdgeUs;
+    uint32_t maxRate;
+    uint32_t totalTravelSteps;
+    uint32_t lostSteps;
+    uint32_t collisions;
+    uint32_t missedPresses;
+    Plunger plungers[SERVO_COUNT];
+
+    KeyEvent keys[SIM_MAX_KEYS];
+    uint8_t keyCount;
+    bool running;
+    uint64_t runStartUs;
+    uint64_t runEndUs;
+    uint64_t lastKeyUs;
+    uint32_t runTravelSteps;
+    uint32_t spanMoveUs;
+    uint32_t spanSteps;
+
+    void step();
+    void updateSwitch();
+    Plunger* plungerOnPin(int pin);
+    float angleAt(const Plunger& p, uint64_t us) const;
+    void trackContact(Plunger& p, uint64_t until);
+    void advance(uint64_t until);
+    void registerKey(Plunger& p, uint64_t atUs);
+    uint8_t keyAt(long position, uint8_t servo, uint8_t& line) const;
+
+    static long railMmToSteps(float mm) { return lroundf(mm * STEPS_PER_MM); }
+    static float stepsToRailMm(long steps) { return steps / (float)STEPS_PER_MM; }
+};
+
+#endif // KEYPAD_SIMULATOR_H
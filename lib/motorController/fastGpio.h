@@ -0,0 +1,66 @@
+#ifndef FAST_GPIO_H
+#define FAST_GPIO_H
+
+#include <Arduino.h>
+#include "hal.h"
+#include "motorConfig.h"
+
+// Pin access for the step ISR. On ESP32 each call compiles to a single
+// write to GPIO.out_w1ts/out_w1tc (or a read of GPIO.in), skipping the pin
+// lookup in digitalWrite/digitalRead. Define APTL_ARDUINO_GPIO to use the
+// HAL calls instead (e.g. when bringing up a new board); the host build always does.
+#if defined(ARDUINO_ARCH_ESP32) && !defined(APTL_ARDUINO_GPIO)
+#include "soc/gpio_struct.h"
+#define APTL_FAST_GPIO 1
+#endif
+
+template <uint8_t PIN>
+struct FastPin {
+    static_assert(PIN < 40, "ESP32 GPIO numbers are 0..39");
+
+    static inline void IRAM_ATTR high() {
+#ifdef APTL_FAST_GPIO
+        if (PIN < 32) GPIO.out_w1ts = (1UL << (PIN & 31));
+        else GPIO.out1_w1ts.val = (1UL << (PIN & 31));
+#else
+        halDigitalWrite(PIN, HIGH);
+#endif
+    }
+
+    static inline void IRAM_ATTR low() {
+#ifdef APTL_FAST_GPIO
+        if (PIN < 32) GPIO.out_w1tc = (1UL << (PIN & 31));
+        else GPIO.out1_w1tc.val = (1UL << (PIN & 31));
+#else
+        halDigitalWrite(PIN, LOW);
+#endif
+    }
+
+    static inline void IRAM_ATTR write(bool level) {
+        if (level) high();
+        else low();
+    }
+
+    static inline bool IRAM_ATTR read() {
+#ifdef APTL_FAST_GPIO
+        if (PIN < 32) return (GPIO.in >> (PIN & 31)) & 1;
+        return (GPIO.in1.val >> (PIN & 31)) & 1;
+#else
+        return halDigitalRead(PIN) == HIGH;
+#endif
+    }
+};
+
+// For pins only known at run time (still a single register read)
+static inline bool IRAM_ATTR fastDigitalRead(uint8_t pin) {
+#ifdef APTL_FAST_GPIO
+    if (pin < 32) return (GPIO.in >> pin) & 1;
+    return (GPIO.in1.val >> (pin - 32)) & 1;
+#else
+    return halDigitalRead(pin) == HIGH;
+#endif
+}
+
+typedef FastPin<STEP_PIN> StepPin;
+
+#endif
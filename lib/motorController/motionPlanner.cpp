@@ -0,0 +1,88 @@
+#include "motionPlanner.h"
+
+MotionPlanner::MotionPlanner()
+    : profile{MIN_SPEED, MIN_SPEED, DEFAULT_ACCELERATION, DEFAULT_JERK},
+    rampLength(0), cruiseHalfPeriodUs(speedToHalfPeriodUs(MIN_SPEED)) {
+}
+
+uint32_t MotionPlanner::speedToHalfPeriodUs(float speed) {
+    if (speed <= 0) return UINT16_MAX;
+    uint32_t halfPeriod = lround((1000000.0 / (speed * STEPS_PER_MM)) / 2);
+    if (halfPeriod < STEP_MIN_HALF_PERIOD_US) halfPeriod = STEP_MIN_HALF_PERIOD_US;
+    if (halfPeriod > UINT16_MAX) halfPeriod = UINT16_MAX;
+    return halfPeriod;
+}
+
+bool MotionPlanner::configure(const MotionProfile& newProfile) {
+    if (newProfile.startSpeed <= 0 || newProfile.cruiseSpeed < newProfile.startSpeed) return false;
+    if (newProfile.acceleration <= 0 || newProfile.jerk < 0) return false;
+
+    profile = newProfile;
+    rampLength = 0;
+
+    if (profile.cruiseSpeed > profile.startSpeed) {
+        if (profile.jerk > 0) buildSCurveRamp();
+        else buildTrapezoidRamp();
+    }
+
+    // If the table filled up before reaching cruise, cruise at the last ramp speed instead
+    cruiseHalfPeriodUs = speedToHalfPeriodUs(profile.cruiseSpeed);
+    if (rampLength > 0 && rampTable[rampLength - 1] > cruiseHalfPeriodUs) {
+        cruiseHalfPeriodUs = rampTable[rampLength - 1];
+    }
+    return true;
+}
+
+// v(i) = sqrt(v0^2 + 2*a*x(i)), evaluated at every step position
+void MotionPlanner::buildTrapezoidRamp() {
+    const double v0sq = (double)profile.startSpeed * profile.startSpeed;
+    for (uint16_t i = 0; i < RAMP_TABLE_SIZE; ++i) {
+        double v = sqrt(v0sq + 2.0 * profile.acceleration * (i / STEPS_PER_MM));
+        if (v >= profile.cruiseSpeed) break;
+        rampTable[rampLength++] = speedToHalfPeriodUs(v);
+    }
+}
+
+// Jerk-limited ramp: acceleration rises at `jerk` up to `acceleration`, then
+// falls again early enough to blend into cruise speed without a step change.
+// Integrated in time, sampled at every step boundary.
+void MotionPlanner::buildSCurveRamp() {
+    const double dt = 0.0001; // 100 us integration step
+    const double stepLength = 1.0 / STEPS_PER_MM;
+    const double aMax = profile.acceleration;
+    const double j = profile.jerk;
+
+    double v = profile.startSpeed;
+    double a = 0;
+    double x = 0;
+    double nextStep = 0;
+
+    while (rampLength < RAMP_TABLE_SIZE && v < profile.cruiseSpeed) {
+        if (x >= nextStep) {
+            rampTable[rampLength++] = speedToHalfPeriodUs(v);
+            nextStep += stepLength;
+        }
+
+        // Velocity still gained while ramping acceleration down to zero
+        double blend = (a * a) / (2.0 * j);
+        if (profile.cruiseSpeed - v <= blend) a -= j * dt;
+        else a += j * dt;
+        if (a > aMax) a = aMax;
+        if (a < j * dt) a = j * dt;
+
+        v += a * dt;
+        x += v * dt;
+    }
+}
+
+unsigned long MotionPlanner::estimateMoveUs(long steps) const {
+    if (steps <= 0) return 0;
+
+    long ramp = rampLength;
+    if (ramp > steps / 2) ramp = steps / 2;
+
+    unsigned long total = 0;
+    for (long i = 0; i < ramp; ++i) total += 2UL * rampTable[i] * 2; // accel + mirrored decel
+    total += 2UL * cruiseHalfPeriodUs * (steps - 2 * ramp);
+    return total;
+}
@@ -0,0 +1,42 @@
+#ifndef MOTION_PLANNER_H
+#define MOTION_PLANNER_H
+
+#include <Arduino.h>
+#include "motorConfig.h"
+
+// Speeds in mm/s, acceleration in mm/s^2, jerk in mm/s^3 (0 = trapezoidal ramp)
+struct MotionProfile {
+    float startSpeed;
+    float cruiseSpeed;
+    float acceleration;
+    float jerk;
+};
+
+// Precomputes the acceleration ramp as a table of step half-periods (us).
+// A move of N steps accelerates through the table, cruises, then walks the
+// same table backwards to decelerate, so per-step lookups are O(1) in the ISR.
+class MotionPlanner {
+public:
+    MotionPlanner();
+    bool configure(const MotionProfile& profile);
+    const MotionProfile& getProfile() const { return profile; }
+
+    const uint16_t* getRampTable() const { return rampTable; }
+    uint16_t getRampLength() const { return rampLength; }
+    uint32_t getCruiseHalfPeriodUs() const { return cruiseHalfPeriodUs; }
+    uint32_t getStartHalfPeriodUs() const { return speedToHalfPeriodUs(profile.startSpeed); }
+
+    unsigned long estimateMoveUs(long steps) const;
+    static uint32_t speedToHalfPeriodUs(float speed);
+
+private:
+    MotionProfile profile;
+    uint16_t rampTable[RAMP_TABLE_SIZE];
+    uint16_t rampLength;
+    uint32_t cruiseHalfPeriodUs;
+
+    void buildTrapezoidRamp();
+    void buildSCurveRamp();
+};
+
+#endif
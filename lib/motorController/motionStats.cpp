@@ -0,0 +1,131 @@
+#include "motionStats.h"
+
+#if APTL_MOTION_STATS
+
+#include "hal.h"
+
+static const char* const OP_NAMES[OP_COUNT] = {"move", "home", "press"};
+
+MotionStats::MotionStats() {
+    reset();
+}
+
+void MotionStats::reset() {
+    for (uint8_t i = 0; i < STATS_JITTER_BUCKETS; i++) jitter[i] = 0;
+    pulseCount = 0;
+    jitterMinUs = UINT32_MAX;
+    jitterMaxUs = 0;
+    lastEdgeUs = 0;
+    expectedPeriodUs = 0;
+
+    memset(speed, 0, sizeof(speed));
+    moveCount = 0;
+    lastMoveSteps = 0;
+    lastMoveUs = 0;
+    lastMoveSps = 0;
+
+    memset(duration, 0, sizeof(duration));
+    memset(opCount, 0, sizeof(opCount));
+    memset(opFailed, 0, sizeof(opFailed));
+    memset(opLastMs, 0, sizeof(opLastMs));
+}
+
+//* PULSE TIMING
+// Called when a move starts, so the first step is not compared against the last move
+void IRAM_ATTR MotionStats::startPulses() {
+    lastEdgeUs = 0;
+}
+
+// Called on every rising edge with the half-period just programmed; the interval
+// since the previous rising edge is compared with the period commanded back then
+void IRAM_ATTR MotionStats::recordEdge(uint32_t halfPeriodUs) {
+    int64_t now = halTimeUs();
+    if (lastEdgeUs) {
+        uint32_t actual = (uint32_t)(now - lastEdgeUs);
+        uint32_t dev = actual > expectedPeriodUs ? actual - expectedPeriodUs : expectedPeriodUs - actual;
+        jitter[jitterBucket(dev)]++;
+        pulseCount++;
+        if (dev < jitterMinUs) jitterMinUs = dev;
+        if (dev > jitterMaxUs) jitterMaxUs = dev;
+    }
+    lastEdgeUs = now;
+    expectedPeriodUs = 2 * halfPeriodUs;
+}
+
+uint8_t IRAM_ATTR MotionStats::jitterBucket(uint32_t us) {
+    if (us < 4) return us;
+    uint8_t bucket = 33 - __builtin_clz(us); // 4-7 us -> 4, 8-15 us -> 5, ...
+    return bucket < STATS_JITTER_BUCKETS ? bucket : STATS_JITTER_BUCKETS - 1;
+}
+
+// Largest deviation that still falls in the bucket
+uint32_t MotionStats::jitterBucketLimit(uint8_t bucket) {
+    if (bucket < 4) return bucket;
+    if (bucket == STATS_JITTER_BUCKETS - 1) return UINT32_MAX;
+    return (1UL << (bucket - 1)) - 1;
+}
+
+uint32_t MotionStats::getJitterP99Us() const {
+    uint32_t total = pulseCount;
+    if (total == 0) return 0;
+    uint32_t threshold = total - total / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < STATS_JITTER_BUCKETS; i++) {
+        seen += jitter[i];
+        if (seen >= threshold) return i == STATS_JITTER_BUCKETS - 1 ? jitterMaxUs : jitterBucketLimit(i);
+    }
+    return jitterMaxUs;
+}
+
+//* MOVES AND OPERATIONS
+void MotionStats::recordMove(long steps, unsigned long wallUs) {
+    if (steps <= 0 || wallUs == 0) return;
+    lastMoveSteps = steps;
+    lastMoveUs = wallUs;
+    lastMoveSps = (uint32_t)((uint64_t)steps * 1000000ULL / wallUs);
+    uint32_t bucket = lastMoveSps / STATS_SPEED_BUCKET_SPS;
+    speed[bucket < STATS_SPEED_BUCKETS ? bucket : STATS_SPEED_BUCKETS - 1]++;
+    moveCount++;
+}
+
+void MotionStats::recordOperation(MotionOp op, unsigned long ms, bool ok) {
+    if (op >= OP_COUNT) return;
+    unsigned long bucket = ms / STATS_DURATION_BUCKET_MS;
+    duration[op][bucket < STATS_DURATION_BUCKETS ? bucket : STATS_DURATION_BUCKETS - 1]++;
+    opCount[op]++;
+    if (!ok) opFailed[op]++;
+    opLastMs[op] = ms;
+}
+
+//* DUMP
+void MotionStats::dump(Print& out) const {
+    out.println("===== Motion Statistics =====");
+    out.printf("Pulses: %u, jitter min %u us, p99 %u us, max %u us\n", (unsigned)pulseCount,
+               pulseCount ? (unsigned)jitterMinUs : 0, (unsigned)getJitterP99Us(), (unsigned)jitterMaxUs);
+    for (uint8_t i = 0; i < STATS_JITTER_BUCKETS; i++) {
+        if (!jitter[i]) continue;
+        if (i == STATS_JITTER_BUCKETS - 1) out.printf("  >= %5u us: %u\n", (unsigned)(1UL << (i - 2)), (unsigned)jitter[i]);
+        else out.printf("  <= %5u us: %u\n", (unsigned)jitterBucketLimit(i), (unsigned)jitter[i]);
+    }
+
+    out.printf("Moves: %u, last %ld steps in %lu us (%u steps/s)\n", (unsigned)moveCount, lastMoveSteps,
+               lastMoveUs, (unsigned)lastMoveSps);
+    for (uint8_t i = 0; i < STATS_SPEED_BUCKETS; i++) {
+        if (!speed[i]) continue;
+        out.printf("  %5u steps/s%s: %u\n", (unsigned)(i * STATS_SPEED_BUCKET_SPS),
+                   i == STATS_SPEED_BUCKETS - 1 ? "+" : "", (unsigned)speed[i]);
+    }
+
+    for (uint8_t op = 0; op < OP_COUNT; op++) {
+        out.printf("%s: %u runs, %u failed, last %lu ms\n", OP_NAMES[op], (unsigned)opCount[op],
+                   (unsigned)opFailed[op], opLastMs[op]);
+        for (uint8_t i = 0; i < STATS_DURATION_BUCKETS; i++) {
+            if (!duration[op][i]) continue;
+            out.printf("  %5u ms%s: %u\n", (unsigned)(i * STATS_DURATION_BUCKET_MS),
+                       i == STATS_DURATION_BUCKETS - 1 ? "+" : "", (unsigned)duration[op][i]);
+        }
+    }
+    out.println("=============================");
+}
+
+#endif // APTL_MOTION_STATS
@@ -0,0 +1,75 @@
+#ifndef MOTION_STATS_H
+#define MOTION_STATS_H
+
+#include <Arduino.h>
+#include "motorConfig.h"
+
+#if APTL_MOTION_STATS
+
+#define STATS_JITTER_BUCKETS 16   // |actual - commanded| step period: 0-3 us, then powers of two
+#define STATS_SPEED_BUCKETS 16    // Achieved speed per move, STATS_SPEED_BUCKET_SPS wide
+#define STATS_SPEED_BUCKET_SPS 200
+#define STATS_DURATION_BUCKETS 16 // Operation wall time, STATS_DURATION_BUCKET_MS wide
+#define STATS_DURATION_BUCKET_MS 100
+
+enum MotionOp : uint8_t {
+    OP_MOVE,
+    OP_HOME,
+    OP_PRESS,
+    OP_COUNT,
+};
+
+// Fixed-size histograms of step timing and motion results. Pulse intervals are
+// timestamped with halTimeUs() from the step ISR; moves and operations are recorded
+// from the motion task. Everything is preallocated, nothing is formatted until dump().
+class MotionStats {
+public:
+    MotionStats();
+    void reset();
+
+    // Step ISR
+    void IRAM_ATTR startPulses();
+    void IRAM_ATTR recordEdge(uint32_t halfPeriodUs);
+
+    // Motion task
+    void recordMove(long steps, unsigned long wallUs);
+    void recordOperation(MotionOp op, unsigned long ms, bool ok);
+
+    uint32_t getJitterP99Us() const;
+    uint32_t getJitterMaxUs() const { return jitterMaxUs; }
+    uint32_t getLastMoveSps() const { return lastMoveSps; }
+
+    void dump(Print& out) const;
+
+private:
+    // Pulse timing (written by the ISR only)
+    volatile uint32_t jitter[STATS_JITTER_BUCKETS];
+    volatile uint32_t pulseCount;
+    volatile uint32_t jitterMinUs;
+    volatile uint32_t jitterMaxUs;
+    volatile int64_t lastEdgeUs;
+    volatile uint32_t expectedPeriodUs;
+
+    // Per move
+    uint32_t speed[STATS_SPEED_BUCKETS];
+    uint32_t moveCount;
+    long lastMoveSteps;
+    unsigned long lastMoveUs;
+    uint32_t lastMoveSps;
+
+    // Per operation
+    uint32_t duration[OP_COUNT][STATS_DURATION_BUCKETS];
+    uint32_t opCount[OP_COUNT];
+    uint32_t opFailed[OP_COUNT];
+    unsigned long opLastMs[OP_COUNT];
+
+    static uint8_t IRAM_ATTR jitterBucket(uint32_t us);
+    static uint32_t jitterBucketLimit(uint8_t bucket);
+};
+
+#define MOTION_STATS(x) x
+#else
+#define MOTION_STATS(x)
+#endif // APTL_MOTION_STATS
+
+#endif // MOTION_STATS_H
@@ -1,24 +1,44 @@
 #ifndef MOTOR_CONFIG_H
 #define MOTOR_CONFIG_H
 
-// Pin definitions for motor control
+// Pin definitions for motor control (hardware variants override these from build_flags in platformio.ini)
+#ifndef STEP_PIN
 #define STEP_PIN 23
+#endif
+#ifndef DIR_PIN
 #define DIR_PIN 22
+#endif
+#ifndef ENABLE_PIN
 #define ENABLE_PIN 21
+#endif
+#ifndef LIMIT_PIN_TOP
 #define LIMIT_PIN_TOP 33
+#endif
+// Optional switches, enable only on hardware that has them fitted (all active LOW, interrupt driven)
 // #define LIMIT_PIN_BOTTOM 32
-// #define LIMIT_PIN_EMERGENCY 34 // Placed in middle of the vertical bar if hits unknown obstacle
+// #define LIMIT_PIN_EMERGENCY 34 // Placed in middle of the vertical bar if hits unknown obstacle. Input-only pin: needs an external pull-up
 #define MIN_SPEED 50
-#define MAX_SPEED 70
+#define MAX_SPEED 70 // Highest speed the motor can start/stop at without a ramp
+#define MAX_CRUISE_SPEED 250 // mm/s, only reachable through the acceleration ramp
+#define DEFAULT_CRUISE_SPEED 150 // mm/s
+#define DEFAULT_ACCELERATION 800.0 // mm/s^2
+#define DEFAULT_JERK 20000.0 // mm/s^3, 0 = trapezoidal ramp
+#define RAMP_TABLE_SIZE 512 // Max steps spent accelerating (one uint16_t per step)
 #define MAX_POSITION_LIMIT 120.0 // mm
 
 #define SERVO_LEFT_PIN 27
 #define SERVO_MIDDLE_PIN 14
 #define SERVO_RIGHT_PIN 13
 
-#define SERVO_RELEASE_ANGLE 0
+#define SERVO_COUNT 3
+
+// Defaults for every servo, each one can be tuned at runtime with setServoProfile()
+#define SERVO_HOVER_ANGLE 0 // Resting angle, plunger just above the keypad
 #define SERVO_PRESS_ANGLE 25
-#define SERVO_PRESS_DURATION 700
+#define SERVO_PRESS_DURATION 700 // Travel from hover to the key
+#define SERVO_HOLD_DURATION 0 // Extra dwell on the key before releasing
+#define SERVO_RELEASE_DURATION 500 // Time for the servo to return before it can press again
+#define SERVO_RELEASE_CLEAR_MS 150 // Time until a releasing servo is clear of the keypad (carriage may move)
 
 #define PULLEY_TEETH 20.0
 #define BELT_PITCH 2.0
@@ -26,5 +46,31 @@
 #define STEPS_PER_REV 200
 #define STEPS_PER_MM (STEPS_PER_REV * MICROSTEPS / (PULLEY_TEETH * BELT_PITCH))
 #define CLEARANCE_STEPS 50 // Steps to move away from limit switch after triggering it
+#define MOVE_SETTLE_MS 50 // Pause after a move before the next action
+
+#define HOMING_FAST_SPEED MAX_SPEED // mm/s, fast approach (unramped, so at most MAX_SPEED)
+#define HOMING_SLOW_SPEED 10 // mm/s, precise re-approach
+#define HOMING_BACKOFF_STEPS 30 // Steps to back off the switch between the two approaches
+#define HOMING_MAX_TRAVEL_MM (MAX_POSITION_LIMIT + 20) // Fail if the switch is not found within this travel
+#define HOMING_TIMEOUT_MS 10000 // Fail if homing takes longer than this
+
+// See IdlePolicy in motorController.h. The axis is vertical and can drift with the driver off,
+// so idle release drops the position; -D DEFAULT_IDLE_POLICY=IDLE_RELEASE_TRUSTED opts out
+#ifndef DEFAULT_IDLE_POLICY
+#define DEFAULT_IDLE_POLICY IDLE_RELEASE
+#endif
+#define DEFAULT_REHOME_INTERVAL_MS (30UL * 60 * 1000) // Re-home before a move if the last homing is older, 0 = never
+
+#define STEP_TIMER_NUM 0 // Hardware timer used by the step pulse generator
+// Shortest high/low half of a step pulse. Lower it with -D only after the "stats" jitter
+// histogram (motionStats.h) shows the step ISR keeps up at the shorter period
+#ifndef STEP_MIN_HALF_PERIOD_US
+#define STEP_MIN_HALF_PERIOD_US 20
+#endif
+
+// Step timing and motion histograms (see motionStats.h), build with -D APTL_MOTION_STATS=0 to leave them out
+#ifndef APTL_MOTION_STATS
+#define APTL_MOTION_STATS 1
+#endif
 
 #endif
\ No newline at end of file
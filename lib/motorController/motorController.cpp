@@ -1,32 +1,78 @@
 #include "motorController.h"
 
+MotorController* MotorController::_instance = nullptr;
+
+// Last known position, kept in RTC memory so it survives software resets (not power loss)
+struct RetainedPosition {
+    uint32_t magic;
+    int32_t position;
+    uint32_t moving;
+    uint32_t checksum;
+};
+static HAL_RETAINED RetainedPosition retained;
+static const uint32_t RETAINED_MAGIC = 0x4150544C; // "APTL"
+
+static uint32_t retainedChecksum(const RetainedPosition& r) {
+    return (r.magic ^ (uint32_t)r.position ^ (r.moving * 0x9E3779B9UL)) + 0x5A5A5A5AUL;
+}
+
 MotorController::MotorController() 
-    : yPosition(0), yMaximumPosition(0), speedDelay(500), 
+    : yPosition(0), yMaximumPosition(0),
     is_calibrated(false),  is_emergency_stop(false), is_disabled(false),
-    idleTimeoutMs(1 * 60 * 1000), lastActivityTimeMs(millis()) { //5 Minutes Default
+    idleTimeoutMs(1 * 60 * 1000), lastActivityTimeMs(halMillis()), //5 Minutes Default
+    state(STATE_IDLE), lastStatus(MOTION_IDLE), callback(nullptr), phaseEndMs(0),
+    pendingTarget(-1), pendingKey(), activeKey(),
+    lastRequestedSteps(0), lastMovedSteps(0), steps_in_flight(false),
+    estopTriggerUs(0), lastStopLatencyUs(0), estop_was_moving(false), estop_reported(true),
+    homingMaxTravelSteps(mmToSteps(HOMING_MAX_TRAVEL_MM)), homingTimeoutMs(HOMING_TIMEOUT_MS),
+    homingFastHalfPeriodUs(MotionPlanner::speedToHalfPeriodUs(HOMING_FAST_SPEED)),
+    homingSlowHalfPeriodUs(MotionPlanner::speedToHalfPeriodUs(HOMING_SLOW_SPEED)),
+    homingStartMs(0), homingDurationMs(0), homingRepeatabilitySteps(0),
+    idlePolicy(DEFAULT_IDLE_POLICY), rehomeIntervalMs(DEFAULT_REHOME_INTERVAL_MS), lastHomedMs(0) {
+    _instance = this;
 }
 
 void MotorController::setSpeed(int speed) {
     Serial.println("Setting speed to: " + String(speed) + " mm/s");
 
-    if (speed < MIN_SPEED || speed > MAX_SPEED) {
-        Serial.println("Speed out of bounds. Please set a value between " + String(MIN_SPEED) + " and " + String(MAX_SPEED) + ".\n");
+    if (speed < MIN_SPEED || speed > MAX_CRUISE_SPEED) {
+        Serial.println("Speed out of bounds. Please set a value between " + String(MIN_SPEED) + " and " + String(MAX_CRUISE_SPEED) + ".\n");
+        return;
+    }
+
+    const MotionProfile& current = planner.getProfile();
+    setMotionProfile(speed, current.acceleration, current.jerk);
+}
+
+void MotorController::setMotionProfile(float cruiseSpeed, float acceleration, float jerk) {
+    if (stepGenerator.isRunning()) {
+        Serial.println("Cannot change motion profile while moving.\n");
         return;
     }
 
-    speedDelay = (1000000.0 / (speed * STEPS_PER_MM)) / 2; // Convert speed to delay in microseconds
-    Serial.println("Speed set to: " + String(speed) + " mm/s\n");
+    // Start at a speed the motor can pull in from standstill, ramp to cruise from there
+    float startSpeed = cruiseSpeed < MIN_SPEED ? cruiseSpeed : MIN_SPEED;
+    MotionProfile profile = {startSpeed, cruiseSpeed, acceleration, jerk};
+    if (cruiseSpeed > MAX_CRUISE_SPEED || !planner.configure(profile)) {
+        Serial.println("Invalid motion profile.\n");
+        return;
+    }
+
+    Serial.println("Motion profile set: cruise " + String(cruiseSpeed) + " mm/s, accel " + String(acceleration) +
+                   " mm/s^2, jerk " + String(jerk) + " mm/s^3, ramp " + String(planner.getRampLength()) + " steps\n");
 }
 
 void MotorController::setMaximumPosition(float max_y) {
     Serial.println("Setting maximum position to: " + String(max_y) + " mm");
 
-    if (max_y <= 0 || max_y > MAX_POSITION_LIMIT) {
+    steps_t maxSteps = mmConvertible(max_y) ? mmToSteps(max_y) : 0;
+    if (maxSteps <= 0 || maxSteps > MAX_POSITION_STEPS) {
         Serial.println("Maximum position must be greater than 0 and less than " + String(MAX_POSITION_LIMIT) + ".\n");
         return;
     }
 
-    yMaximumPosition = lround(max_y * STEPS_PER_MM);
+    yMaximumPosition = maxSteps;
+    DeviceConfigLock lock;
     setMaxPosition(max_y);
     Serial.println("Maximum position set to: " + String(max_y) + " mm\n");
 }
@@ -36,25 +82,31 @@ void MotorController::setup() {
     Serial.println("Setting up motor and servos...\n");
 
     // Motor pin setup
-    pinMode(STEP_PIN, OUTPUT);
-    pinMode(DIR_PIN, OUTPUT);
-    pinMode(ENABLE_PIN, OUTPUT);
-    digitalWrite(ENABLE_PIN, LOW);
-    setSpeed(MIN_SPEED); // Set initial speed to minimum
-
-    // Limit switch pin setup
-    pinMode(LIMIT_PIN_TOP, INPUT_PULLUP);
-    // pinMode(LIMIT_PIN_BOTTOM, INPUT_PULLUP);
-    // pinMode(LIMIT_PIN_EMERGENCY, INPUT_PULLUP);
+    halPinMode(STEP_PIN, OUTPUT);
+    halPinMode(DIR_PIN, OUTPUT);
+    halPinMode(ENABLE_PIN, OUTPUT);
+    halDigitalWrite(ENABLE_PIN, LOW);
+    halDigitalWrite(STEP_PIN, LOW);
+    stepGenerator.begin();
+    MOTION_STATS(stepGenerator.setStats(&stats);)
+    setMotionProfile(DEFAULT_CRUISE_SPEED, DEFAULT_ACCELERATION, DEFAULT_JERK);
+
+    // Limit switch pin setup (interrupts halt the axis at the next step boundary)
+    halPinMode(LIMIT_PIN_TOP, INPUT_PULLUP);
+    halAttachInterrupt(LIMIT_PIN_TOP, _onLimitTop, FALLING);
+#ifdef LIMIT_PIN_BOTTOM
+    halPinMode(LIMIT_PIN_BOTTOM, INPUT_PULLUP);
+    halAttachInterrupt(LIMIT_PIN_BOTTOM, _onLimitBottom, FALLING);
+#endif
+#ifdef LIMIT_PIN_EMERGENCY
+    halPinMode(LIMIT_PIN_EMERGENCY, INPUT);
+    halAttachInterrupt(LIMIT_PIN_EMERGENCY, _onEmergencyPin, FALLING);
+#endif
  
     // Servo pin setup
-    servo_left.attach(SERVO_LEFT_PIN);
-    servo_middle.attach(SERVO_MIDDLE_PIN);
-    servo_right.attach(SERVO_RIGHT_PIN);
+    servos.begin();
 
-    servo_left.write(SERVO_RELEASE_ANGLE);
-    servo_middle.write(SERVO_RELEASE_ANGLE);
-    servo_right.write(SERVO_RELEASE_ANGLE);
+    restoreRetainedPosition();
 
     Serial.println("Motor and servos setup complete.\n");
 }
@@ -62,352 +114,599 @@ void MotorController::setup() {
 
 //* STEPPER FUNCTIONS
 bool MotorController::calibrate() {
-    Serial.println("Calibrating tool position...");
+    if (!calibrateAsync()) return false;
+    return waitForIdle() == MOTION_DONE;
+}
 
-    // Move to the top limit
-    digitalWrite(DIR_PIN, LOW);
-    while (digitalRead(LIMIT_PIN_TOP) == HIGH) {
-        digitalWrite(STEP_PIN, HIGH);
-        delayMicroseconds(speedDelay);
-        digitalWrite(STEP_PIN, LOW);
-        delayMicroseconds(speedDelay);
-    }
-    stepMotor(true, CLEARANCE_STEPS);
-    yPosition = 0;
-    is_calibrated = true;
-    delay(1000);
+void MotorController::moveTo(float y) {
+    if (moveToAsync(y)) waitForIdle();
+}
 
-    Serial.println("Calibration complete\n");
-    return true;
+void MotorController::moveBy(float dy) {
+    if (moveByAsync(dy)) waitForIdle();
 }
 
-void MotorController::moveTo(float y) {
+long MotorController::stepMotor(bool move_down, long steps) {
     refreshIdle();
 
-    if (isnan(y) || isinf(y)) {
-        Serial.println("Invalid target position.\n");
-        return;
+    if (isBusy()) {
+        Serial.println("Motor is busy. Cannot step motor.\n");
+        return 0;
     }
+    callback = nullptr;
+    pendingTarget = -1;
+    pendingKey.servo = 0;
+    MOTION_STATS(beginOperation(OP_MOVE);)
+    if (!startSteps(move_down, steps, STATE_MOVING)) return 0;
+    waitForIdle();
+    return lastMovedSteps;
+}
 
-    if (!is_calibrated) {
-        Serial.println("Motor not calibrated. Please calibrating.\n");
-        bool calibrateSuccess = calibrate();
-        if (!calibrateSuccess) {
-            Serial.println("Calibration failed. Aborting move.\n");
-            return;
-        }
-        Serial.println("Calibration successful. Continuing move.");
+MotionStatus MotorController::waitForIdle() {
+    while (isBusy()) {
+        update();
+        halDelay(1); // yields to the RTOS while the timer emits pulses
     }
+    return lastStatus;
+}
 
-    if (is_emergency_stop) {
-        Serial.println("Emergency stop is active. Cannot move.\n");
-        return;
+//* ASYNC MOTION
+bool MotorController::calibrateAsync(MotionCallback cb) {
+    refreshIdle();
+
+    if (isBusy()) {
+        Serial.println("Motor is busy. Cannot calibrate.\n");
+        return false;
     }
 
-    if (yMaximumPosition == 0) {
-        Serial.println("Maximum position not set. Please set it first.\n");
-        return;
+    callback = cb;
+    pendingTarget = -1;
+    pendingKey.servo = 0;
+    MOTION_STATS(beginOperation(OP_HOME);)
+    startHoming();
+    return true;
+}
+
+bool MotorController::moveToAsync(float y, MotionCallback cb) {
+    refreshIdle();
+
+    if (!mmConvertible(y)) {
+        Serial.println("Invalid target position.\n");
+        return false;
     }
 
     Serial.println("Moving to position: " + String(y));
+    return moveToStepsAsync(mmToSteps(y), cb);
+}
 
-    long yTargetPosition = lround(y * STEPS_PER_MM);
+bool MotorController::moveToStepsAsync(steps_t yTargetPosition, MotionCallback cb) {
+    refreshIdle();
 
-    if (yTargetPosition < 0 || yTargetPosition > yMaximumPosition || yTargetPosition > (MAX_POSITION_LIMIT * STEPS_PER_MM)) {
-        Serial.print("Target position out of bounds. yTarget: ");
-        return;
+    if (yMaximumPosition == 0) {
+        Serial.println("Maximum position not set. Please set it first.\n");
+        return false;
     }
 
-    long steps = yTargetPosition - yPosition;
-    if (steps == 0) {
-        Serial.println("Already at target position.\n");
-        return;
-    }
-    long moved = stepMotor(steps > 0, abs(steps));
-    if (moved < abs(steps)) {
-        Serial.println("Warning: Movement was limited by emergency stop or limit switch.\n");
+    if (yTargetPosition < 0 || yTargetPosition > yMaximumPosition || yTargetPosition > MAX_POSITION_STEPS) {
+        Serial.println("Target position out of bounds. yTarget: " + String(stepsToMm(yTargetPosition)) + "\n");
+        return false;
     }
 
-    Serial.println("Moved to position: " + String(y) + "\n");
+    return beginMove(yTargetPosition, nullptr, cb);
 }
 
-void MotorController::moveBy(float dy) {
+bool MotorController::moveByAsync(float dy, MotionCallback cb) {
     refreshIdle();
 
-    if (isnan(dy) || isinf(dy)) {
+    if (!mmConvertible(dy)) {
         Serial.println("Invalid movement value.\n");
-        return;
+        return false;
     }
 
     Serial.println("Moving by: " + String(dy) + " mm");
 
+    steps_t yTargetPosition = yPosition + mmToSteps(dy);
+
+    if (yTargetPosition < 0 || yTargetPosition > MAX_POSITION_STEPS) {
+        Serial.println("Target position out of bounds.\n");
+        return false;
+    }
+
+    return beginMove(yTargetPosition, nullptr, cb);
+}
+
+bool MotorController::pressAsync(int num_servo, MotionCallback cb) {
+    Serial.println("Pressing servo: " + String(num_servo));
+    KeyBinding key = {0, (uint8_t)num_servo, 0, 0};
+    return pressKeyAsync(key, cb);
+}
+
+bool MotorController::pressKeyAsync(const KeyBinding& key, MotionCallback cb) {
+    refreshIdle();
+
+    if (isBusy()) {
+        Serial.println("Motor is busy. Cannot press button.\n");
+        return false;
+    }
+
     if (!is_calibrated) {
-        Serial.println("Tool not calibrated. Calibrating first.");
-        float tempCurrentPosition = getCurrentPosition();
-        bool calibrateSuccess = calibrate();
-        if (!calibrateSuccess) {
-            Serial.println("Calibration failed. Aborting move.\n");
-            return;
-        }
-        Serial.println("Calibration successful. Continuing move from latest position.");
-        moveTo(tempCurrentPosition); // Move back to the original position after calibration
+        Serial.println("Tool not calibrated. Please calibrate first.\n");
+        return false;
+    }
+
+    if (is_emergency_stop) {
+        Serial.println("Emergency stop is active. Cannot press button.\n");
+        return false;
+    }
+
+    if (!servos.isValid(key.servo)) {
+        Serial.println("Invalid servo number.\n");
+        return false;
+    }
+
+    callback = cb;
+    pendingTarget = -1;
+    pendingKey.servo = 0;
+    MOTION_STATS(beginOperation(OP_PRESS);)
+    startPress(key);
+    return true;
+}
+
+bool MotorController::beginMove(steps_t yTargetPosition, const KeyBinding* pressAfter, MotionCallback cb) {
+    if (isBusy()) {
+        Serial.println("Motor is busy. Cannot start move.\n");
+        return false;
     }
 
     if (is_emergency_stop) {
         Serial.println("Emergency stop is active. Cannot move.\n");
-        return;
+        return false;
     }
 
-    // if (yMaximumPosition == 0 && !is_max_position_setting) {
-    //     Serial.println("Maximum position not set. Please set it first.\n");
-    //     return;
-    // }
+    if (pressAfter && !servos.isValid(pressAfter->servo)) {
+        Serial.println("Invalid servo number.\n");
+        return false;
+    }
 
-    // if (is_max_position_setting) {
-    //     Serial.println("WARNING: Currently setting maximum position. Be careful when moving the tool manually.\n");
-    // }
+    callback = cb;
+    pendingTarget = yTargetPosition;
+    pendingKey.servo = 0;
+    if (pressAfter) pendingKey = *pressAfter;
+    MOTION_STATS(beginOperation(pressAfter ? OP_PRESS : OP_MOVE);)
 
-    long yTargetPosition = yPosition + lround(dy * STEPS_PER_MM); //! LOOKAT THE CONVERSION FACTOR IN motorConfig.h
+    if (needsHoming()) {
+        Serial.println("Position not trusted. Calibrating before move.");
+        startHoming();
+        return true;
+    }
 
-    // if (yTargetPosition < 0 || yTargetPosition > yMaximumPosition && !is_max_position_setting || yTargetPosition > MAX_POSITION_LIMIT) {
-    //     Serial.println("Target position out of bounds.\n");
-    //     return;
-    // }
+    continueChain();
+    return true;
+}
 
-    if (yTargetPosition < 0 || yTargetPosition > (MAX_POSITION_LIMIT * STEPS_PER_MM)) {
-        Serial.println("Target position out of bounds.\n");
-        return;
+void MotorController::update() {
+    servos.update(); // Servos keep returning in the background, also while idle
+
+    if (is_emergency_stop) {
+        reportEmergencyStop();
+
+        // Moves end on their own at the next step boundary; timed phases are cut short here
+        if (state == STATE_SETTLING || state == STATE_PRESS_WAIT || state == STATE_PRESSING) {
+            servos.releaseAll();
+            activeKey.servo = 0;
+            finish(MOTION_FAILED);
+            return;
+        }
+    }
+
+    if (state == STATE_IDLE) return;
+
+    lastActivityTimeMs = halMillis(); // avoid idle timeout during long moves
+
+    switch (state) {
+        case STATE_HOMING_FAST:
+            if (stepGenerator.isRunning()) return;
+            commitSteps();
+            if (homingAborted()) return;
+            if (halDigitalRead(LIMIT_PIN_TOP) != LOW) {
+                failHoming("Top limit not found within maximum travel");
+                return;
+            }
+            // Back off until the switch releases, then re-approach slowly for a precise trigger point
+            if (!startSteps(true, HOMING_BACKOFF_STEPS, STATE_HOMING_BACKOFF, homingFastHalfPeriodUs)) finish(MOTION_FAILED);
+            return;
+
+        case STATE_HOMING_BACKOFF:
+            if (stepGenerator.isRunning()) return;
+            commitSteps();
+            if (homingAborted()) return;
+            if (halDigitalRead(LIMIT_PIN_TOP) == LOW) {
+                failHoming("Top limit did not release after back-off");
+                return;
+            }
+            if (!startSteps(false, 2 * HOMING_BACKOFF_STEPS, STATE_HOMING_SLOW, homingSlowHalfPeriodUs)) finish(MOTION_FAILED);
+            return;
+
+        case STATE_HOMING_SLOW:
+            if (stepGenerator.isRunning()) return;
+            commitSteps();
+            if (homingAborted()) return;
+            if (halDigitalRead(LIMIT_PIN_TOP) != LOW) {
+                failHoming("Top limit not found on slow approach");
+                return;
+            }
+            // Distance between the fast and the slow trigger point
+            homingRepeatabilitySteps = lastMovedSteps - HOMING_BACKOFF_STEPS;
+
+            // Back off the switch so it is released before normal moves
+            if (!startSteps(true, CLEARANCE_STEPS, STATE_HOMING_CLEAR, homingFastHalfPeriodUs)) finish(MOTION_FAILED);
+            return;
+
+        case STATE_HOMING_CLEAR:
+            if (stepGenerator.isRunning()) return;
+            commitSteps();
+            if (homingAborted()) return;
+            yPosition = 0;
+            is_calibrated = true;
+            lastHomedMs = halMillis();
+            retainPosition(false);
+            homingDurationMs = halMillis() - homingStartMs;
+            Serial.println("Calibration complete in " + String(homingDurationMs) + " ms (repeatability " +
+                           String(homingRepeatabilitySteps) + " steps)\n");
+            continueChain();
+            return;
+
+        case STATE_MOVING:
+            if (stepGenerator.isRunning()) return;
+            commitSteps();
+            if (lastMovedSteps < lastRequestedSteps) {
+                // Short of the target (e-stop, limit switch): a pending press would hit the wrong row
+                Serial.println("Movement was cut short by emergency stop or limit switch, press cancelled.");
+                finish(MOTION_FAILED);
+                return;
+            }
+            Serial.println("Moved to position: " + String(getCurrentPosition()) + "\n");
+            settle(MOVE_SETTLE_MS);
+            return;
+
+        case STATE_SETTLING:
+            if ((long)(halMillis() - phaseEndMs) < 0) return;
+            continueChain();
+            return;
+
+        case STATE_PRESS_WAIT:
+            if (!servos.press(activeKey.servo, activeKey.pressAngle, activeKey.holdMs)) return;
+            state = STATE_PRESSING;
+            return;
+
+        case STATE_PRESSING:
+            if (!servos.isClear(activeKey.servo)) return;
+            Serial.println("Button " + String(activeKey.servo) + " pressed.\n");
+            activeKey.servo = 0;
+            continueChain();
+            return;
+
+        default:
+            return;
     }
+}
 
-    long steps = yTargetPosition - yPosition;
-    if (steps == 0) {
-        Serial.println("Already at target position.\n");
+void MotorController::startHoming() {
+    Serial.println("Calibrating tool position...");
+    is_calibrated = false;
+    retained.magic = 0; // The carriage leaves the retained position: a reset now must re-home
+    lastStatus = MOTION_BUSY;
+    homingStartMs = halMillis();
+
+    if (halDigitalRead(LIMIT_PIN_TOP) == LOW) {
+        // Already on the switch, go straight to the back-off
+        state = STATE_HOMING_FAST;
         return;
     }
-    long moved = stepMotor(steps > 0, abs(steps));
-    if (moved < abs(steps)) {
-        Serial.println("Warning: Movement was limited by emergency stop or limit switch.\n");
+    // Fast approach to the top limit (the step generator stops itself when the switch closes)
+    if (!startSteps(false, homingMaxTravelSteps, STATE_HOMING_FAST, homingFastHalfPeriodUs)) finish(MOTION_FAILED);
+}
+
+// Checked after every homing phase; the time budget covers the whole routine
+bool MotorController::homingAborted() {
+    if (is_emergency_stop) {
+        failHoming("Emergency stop");
+        return true;
+    }
+    if (halMillis() - homingStartMs > homingTimeoutMs) {
+        failHoming("Timed out");
+        return true;
     }
+    return false;
+}
 
-    Serial.println("Moved by: " + String(dy) + "\n");
+void MotorController::failHoming(const char* reason) {
+    homingDurationMs = halMillis() - homingStartMs;
+    Serial.println("Calibration failed: " + String(reason) + "\n");
+    finish(MOTION_FAILED);
 }
 
-long MotorController::stepMotor(bool move_down, long steps) {
-    refreshIdle();
+void MotorController::setHomingLimits(float maxTravelMm, unsigned long timeoutMs) {
+    steps_t maxTravelSteps = mmConvertible(maxTravelMm) ? mmToSteps(maxTravelMm) : 0;
+    if (maxTravelSteps <= 0 || timeoutMs == 0) {
+        Serial.println("Invalid homing limits.\n");
+        return;
+    }
+    homingMaxTravelSteps = maxTravelSteps;
+    homingTimeoutMs = timeoutMs;
+    Serial.println("Homing limits set: " + String(maxTravelMm) + " mm, " + String(timeoutMs) + " ms\n");
+}
 
+bool MotorController::startSteps(bool move_down, long steps, MotionState nextState, uint32_t halfPeriodUs) {
     if (is_emergency_stop) {
         Serial.println("Emergency stop is active. Cannot move motor.\n");
-        return 0;
+        return false;
     }
 
-    if (digitalRead(LIMIT_PIN_TOP) == LOW && !move_down) {
+    if (halDigitalRead(LIMIT_PIN_TOP) == LOW && !move_down) {
         Serial.println("Top limit switch triggered. Cannot move up.\n");
-        return 0;
+        return false;
     }
 
+#ifdef LIMIT_PIN_BOTTOM
+    if (halDigitalRead(LIMIT_PIN_BOTTOM) == LOW && move_down) {
+        Serial.println("Bottom limit switch triggered. Cannot move down.\n");
+        return false;
+    }
+    const int stopPin = move_down ? LIMIT_PIN_BOTTOM : LIMIT_PIN_TOP;
+#else
+    const int stopPin = move_down ? -1 : LIMIT_PIN_TOP;
+#endif
+
     if (steps <= 0) {
         Serial.println("No steps to move.\n");
-        return 0;
+        return false;
     }
 
-    digitalWrite(ENABLE_PIN, LOW);
-    digitalWrite(DIR_PIN, move_down ? HIGH : LOW); // Set direction
+    if (!servos.allClear()) {
+        Serial.println("Servo still on the keypad. Cannot move motor.\n");
+        return false;
+    }
 
-    long moved = 0;
-    for (long i = 0; i < steps; ++i) {
-        // abort checks inside loop
-        if (is_emergency_stop) {
-            Serial.println("Emergency stop detected - halting.\n");
-            break;
-        }
-        if (digitalRead(LIMIT_PIN_TOP) == LOW && !move_down) {
-            Serial.println("Top limit reached - stopping.\n");
-            break;
-        }
+    halDigitalWrite(ENABLE_PIN, LOW);
+    halDigitalWrite(DIR_PIN, move_down ? HIGH : LOW); // Set direction
+
+    // Pulses are generated by the hardware timer. Besides the limit interrupts, the switch
+    // in the direction of travel is also sampled before every step in case it is already closed
+    bool started;
+    if (halfPeriodUs == 0) {
+        started = stepGenerator.startRamped(move_down, steps, planner.getRampTable(), planner.getRampLength(),
+                                            planner.getCruiseHalfPeriodUs(), stopPin);
+    } else {
+        // Homing runs unramped so it can stop dead on the switch
+        started = stepGenerator.start(move_down, steps, halfPeriodUs, stopPin);
+    }
+    if (!started) return false;
+
+    if (is_calibrated) retainPosition(true);
+    steps_in_flight = true;
+    lastRequestedSteps = steps;
+    lastMovedSteps = 0;
+    state = nextState;
+    lastStatus = MOTION_BUSY;
+    return true;
+}
 
-        digitalWrite(STEP_PIN, HIGH);
-        delayMicroseconds(speedDelay);
-        digitalWrite(STEP_PIN, LOW);
-        delayMicroseconds(speedDelay);
+void MotorController::commitSteps() {
+    if (!steps_in_flight) return;
 
-        ++moved;
-        // occasionally refresh to avoid idle timeout during long moves
-        if ((moved & 0xFF) == 0) refreshIdle();
+    // Update yPosition according to actual moved steps
+    long moved = stepGenerator.getStepsDone();
+    if (stepGenerator.isMovingDown()) yPosition += moved;
+    else yPosition -= moved;
+
+    if (stepGenerator.stoppedByPin()) {
+        Serial.println("Limit switch reached - stopping.\n");
+        // Hitting a switch outside homing means the counted position was wrong
+        if (state == STATE_MOVING && is_calibrated) {
+            Serial.println("Position trust lost, next move will re-home.\n");
+            is_calibrated = false;
+        }
+    } else if (moved < lastRequestedSteps && is_emergency_stop) {
+        Serial.println("Emergency stop detected - halting.\n");
+        // Only MAX_SPEED is safe to stop at without a ramp; faster, the motor may have slipped
+        if (is_calibrated && stepGenerator.getLastHalfPeriodUs() < MotionPlanner::speedToHalfPeriodUs(MAX_SPEED)) {
+            Serial.println("Stopped above the unramped speed limit, position trust lost.\n");
+            is_calibrated = false;
+            retained.magic = 0;
+        }
     }
 
-    // Update yPosition according to actual moved steps
-    if (moved > 0) {
-        if (move_down) {
-            yPosition += moved;
+    lastMovedSteps = moved;
+    MOTION_STATS(stats.recordMove(moved, stepGenerator.getStoppedAtUs() - stepGenerator.getStartedAtUs());)
+    steps_in_flight = false;
+    if (is_calibrated) retainPosition(false);
+}
 
-            // if (yMaximumPosition > 0 && yPosition > yMaximumPosition) {
-            //     yPosition = yMaximumPosition;
-            // }
+void MotorController::continueChain() {
+    if (pendingTarget >= 0) {
+        steps_t steps = pendingTarget - yPosition;
+        pendingTarget = -1;
+        if (steps == 0) {
+            Serial.println("Already at target position.\n");
         } else {
-            yPosition -= moved;
+            if (!startSteps(steps > 0, labs(steps), STATE_MOVING)) finish(MOTION_FAILED);
+            return;
+        }
+    }
 
-            // long minPosition = CLEARANCE_STEPS;
-            // if (yPosition < minPosition) {
-            //     yPosition = minPosition;
-            // }
+    if (pendingKey.servo) {
+        KeyBinding key = pendingKey;
+        pendingKey.servo = 0;
+        if (is_emergency_stop) {
+            Serial.println("Emergency stop is active. Cannot press button.\n");
+            finish(MOTION_FAILED);
+            return;
         }
+        startPress(key);
+        return;
     }
 
-    delay(50);
-    return moved;
+    finish(MOTION_DONE);
+}
+
+// The press is handed to the servo engine; if this servo is still returning from its
+// last press it is queued until it reaches hover
+void MotorController::startPress(const KeyBinding& key) {
+    activeKey = key;
+    state = servos.press(key.servo, key.pressAngle, key.holdMs) ? STATE_PRESSING : STATE_PRESS_WAIT;
+    lastStatus = MOTION_BUSY;
+}
+
+#if APTL_MOTION_STATS
+void MotorController::beginOperation(MotionOp op) {
+    opKind = op;
+    opStartMs = halMillis();
+}
+#endif
+
+void MotorController::settle(unsigned long ms) {
+    phaseEndMs = halMillis() + ms;
+    state = STATE_SETTLING;
+}
+
+void MotorController::finish(MotionStatus status) {
+    state = STATE_IDLE;
+    lastStatus = status;
+    pendingTarget = -1;
+    pendingKey.servo = 0;
+    MOTION_STATS(stats.recordOperation(opKind, halMillis() - opStartMs, status == MOTION_DONE);)
+
+    // Cleared before the call so the callback can start the next operation
+    MotionCallback cb = callback;
+    callback = nullptr;
+    if (cb) cb(status);
+}
+
+steps_t MotorController::getPositionSteps() const {
+    steps_t position = yPosition;
+    if (steps_in_flight) {
+        long moved = stepGenerator.getStepsDone();
+        position += stepGenerator.isMovingDown() ? moved : -moved;
+    }
+    return position;
 }
 
 void MotorController::disableMotor() {
     if (is_disabled) return;
-    digitalWrite(ENABLE_PIN, HIGH); // Disable motor driver
+    halDigitalWrite(ENABLE_PIN, HIGH); // Disable motor driver
     is_disabled = true;
-    is_calibrated = false;
+    if (idlePolicy == IDLE_RELEASE) {
+        is_calibrated = false;
+        retained.magic = 0;
+    }
     Serial.println("Motor disabled.\n");
 }
 
 
-//* SERVO FUNCTIONS
-void MotorController::pressButton(int num_servo) {
-    refreshIdle();
+//* POSITION RETENTION
+bool MotorController::needsHoming() const {
+    if (!is_calibrated) return true;
+    return rehomeIntervalMs && (halMillis() - lastHomedMs >= rehomeIntervalMs);
+}
 
-    Serial.println("Pressing servo: " + String(num_servo));
+void MotorController::setIdlePolicy(IdlePolicy policy, unsigned long rehomeMs) {
+    idlePolicy = policy;
+    rehomeIntervalMs = rehomeMs;
+    Serial.println("Idle policy set to: " + String((int)policy) + ", forced re-home every " + String(rehomeMs) + " ms\n");
+}
 
-    if (!is_calibrated) {
-        Serial.println("Tool not calibrated. Please calibrate first.\n");
-        return;
-    }
+void MotorController::retainPosition(bool moving) {
+    retained.magic = RETAINED_MAGIC;
+    retained.position = yPosition;
+    retained.moving = moving ? 1 : 0;
+    retained.checksum = retainedChecksum(retained);
+}
 
-    if (is_emergency_stop) {
-        Serial.println("Emergency stop is active. Cannot press button.\n");
-        return;
-    }
+// Called from setup(): after a software reset the position is trusted again if the
+// last record is intact and was not written in the middle of a move
+bool MotorController::restoreRetainedPosition() {
+    bool cleanReset = halCleanReset();
+    bool valid = retained.magic == RETAINED_MAGIC && retained.checksum == retainedChecksum(retained);
 
-    switch (num_servo) {
-        case 1:
-            servo_left.write(SERVO_PRESS_ANGLE);
-            delay(SERVO_PRESS_DURATION);
-            servo_left.write(SERVO_RELEASE_ANGLE);
-            break;
-        case 2:
-            servo_middle.write(SERVO_PRESS_ANGLE);
-            delay(SERVO_PRESS_DURATION);
-            servo_middle.write(SERVO_RELEASE_ANGLE);
-            break;
-        case 3:
-            servo_right.write(SERVO_PRESS_ANGLE);
-            delay(SERVO_PRESS_DURATION);
-            servo_right.write(SERVO_RELEASE_ANGLE);
-            break;
-        default:
-            Serial.println("Invalid servo number.\n");
-            return;
+    if (idlePolicy == IDLE_RELEASE || !cleanReset || !valid || retained.moving) {
+        retained.magic = 0;
+        return false;
     }
-    delay(500);
-    
-    Serial.println("Button " + String(num_servo) + " pressed.\n");
+
+    yPosition = retained.position;
+    is_calibrated = true;
+    lastHomedMs = halMillis();
+    Serial.println("Restored retained position: " + String(getCurrentPosition()) + " mm\n");
+    return true;
+}
+
+
+//* SERVO FUNCTIONS
+void MotorController::pressButton(int num_servo) {
+    if (pressAsync(num_servo)) waitForIdle();
 }
 
 void MotorController::pressSpecificButton(int button) {
+    if (pressSpecificButtonAsync(button)) waitForIdle();
+}
+
+bool MotorController::setServoProfile(int num_servo, const ServoProfile& profile) {
+    if (!servos.setProfile(num_servo, profile)) {
+        Serial.println("Invalid servo profile for servo " + String(num_servo) + ".\n");
+        return false;
+    }
+    Serial.println("Servo " + String(num_servo) + " profile set: hover " + String(profile.hoverAngle) + ", press " +
+                   String(profile.pressAngle) + ", " + String(profile.pressMs) + "/" + String(profile.holdMs) + "/" +
+                   String(profile.releaseMs) + " ms\n");
+    return true;
+}
+
+bool MotorController::pressSpecificButtonAsync(int button, MotionCallback cb) {
     refreshIdle();
 
-    float coord;
+    steps_t yTargetPosition;
+    const KeyBinding* key = resolveButton(button, yTargetPosition);
+    if (!key) return false;
 
     Serial.println("Pressing specific button: " + String(button));
-
-    if (!is_calibrated) {
-        Serial.println("Tool not calibrated. Please calibrate first.\n");
-        return;
+    if (isBusy()) {
+        Serial.println("Motor is busy. Cannot press button.\n");
+        return false;
     }
+    if (yMaximumPosition == 0) {
+        Serial.println("Maximum position not set. Please set it first.\n");
+        return false;
+    }
+    if (yTargetPosition < 0 || yTargetPosition > yMaximumPosition) {
+        Serial.println("Button " + String(button) + " coordinate out of bounds.\n");
+        return false;
+    }
+    return beginMove(yTargetPosition, key, cb);
+}
 
-    if (is_emergency_stop) {
-        Serial.println("Emergency stop is active. Cannot press button.\n");
-        return;
+// Maps a keypad button to its row position (steps) and servo through the active keypad layout
+const KeyBinding* MotorController::resolveButton(int button, steps_t& yTargetPosition) const {
+    const KeypadLayout& layout = getKeypadLayout();
+    if (button < 0 || button >= layout.buttonCount || layout.keys[button].line == 0) {
+        Serial.println("Invalid button number. Please press a button between 0 and " + String(layout.buttonCount - 1) + ".\n");
+        return nullptr;
     }
 
-    if (button < 0 || button > 11) {
-        Serial.println("Invalid button number. Please press a button between 0 and 11.\n");
-        return;
+    const KeyBinding& key = layout.keys[button];
+    float coord = getLineCoordinate(key.line);
+    if (!mmConvertible(coord)) {
+        Serial.println("Error: Line " + String(key.line) + " coordinate not set. Cannot press button " + String(button) + ".\n");
+        return nullptr;
     }
 
-    switch (button) {
-        case 0:
-            coord = getLineCoordinate(4);
-            if (isnan(coord)) { Serial.println("Error: Line 4 coordinate not set. Cannot press button 0 (Clear).\n"); return; }
-            moveTo(coord);
-            pressButton(2);
-            break;
-        case 1:
-            coord = getLineCoordinate(1);
-            if (isnan(coord)) { Serial.println("Error: Line 1 coordinate not set. Cannot press button 1.\n"); return; }
-            moveTo(coord);
-            pressButton(1);
-            break;
-        case 2:
-            coord = getLineCoordinate(1);
-            if (isnan(coord)) { Serial.println("Error: Line 1 coordinate not set. Cannot press button 2.\n"); return; }
-            moveTo(coord);
-            pressButton(2);
-            break;
-        case 3:
-            coord = getLineCoordinate(1);
-            if (isnan(coord)) { Serial.println("Error: Line 1 coordinate not set. Cannot press button 3.\n"); return; }
-            moveTo(coord);
-            pressButton(3);
-            break;
-        case 4:
-            coord = getLineCoordinate(2);
-            if (isnan(coord)) { Serial.println("Error: Line 2 coordinate not set. Cannot press button 4.\n"); return; }
-            moveTo(coord);
-            pressButton(1);
-            break;
-        case 5:
-            coord = getLineCoordinate(2);
-            if (isnan(coord)) { Serial.println("Error: Line 2 coordinate not set. Cannot press button 5.\n"); return; }
-            moveTo(coord);
-            pressButton(2);
-            break;
-        case 6:
-            coord = getLineCoordinate(2);
-            if (isnan(coord)) { Serial.println("Error: Line 2 coordinate not set. Cannot press button 6.\n"); return; }
-            moveTo(coord);
-            pressButton(3);
-            break;
-        case 7:
-            coord = getLineCoordinate(3);
-            if (isnan(coord)) { Serial.println("Error: Line 3 coordinate not set. Cannot press button 7.\n"); return; }
-            moveTo(coord);
-            pressButton(1);
-            break;
-        case 8:
-            coord = getLineCoordinate(3);
-            if (isnan(coord)) { Serial.println("Error: Line 3 coordinate not set. Cannot press button 8.\n"); return; }
-            moveTo(coord);
-            pressButton(2);
-            break;
-        case 9:
-            coord = getLineCoordinate(3);
-            if (isnan(coord)) { Serial.println("Error: Line 3 coordinate not set. Cannot press button 9.\n"); return; }
-            moveTo(coord);
-            pressButton(3);
-            break;
-        case 10: // Backspace
-            coord = getLineCoordinate(4);
-            if (isnan(coord)) { Serial.println("Error: Line 4 coordinate not set. Cannot press button 10.\n"); return; }
-            moveTo(coord);
-            pressButton(1);
-            break;
-        case 11: // Submit
-            coord = getLineCoordinate(4);
-            if (isnan(coord)) { Serial.println("Error: Line 4 coordinate not set. Cannot press button 11.\n"); return; }
-            moveTo(coord);
-            pressButton(3);
-            break;
-        default:
-            Serial.println("Invalid button number. Please press a button between 0 and 11.\n");
-            return;
+    if (!servos.isValid(key.servo)) {
+        Serial.println("Error: Button " + String(button) + " has no servo " + String(key.servo) + ".\n");
+        return nullptr;
     }
 
-    Serial.println("Specific button: " + String(button) + " pressed.\n");
+    yTargetPosition = mmToSteps(coord);
+    return &key;
 }
 
 
@@ -418,17 +717,17 @@ void MotorController::setIdleTimeout(unsigned long ms) {
 }
 
 void MotorController::checkIdle() {
-    if (idleTimeoutMs == 0) return; // disabled timer if 0
-    if (!is_disabled && (millis() - lastActivityTimeMs >= idleTimeoutMs)) {
+    if (idleTimeoutMs == 0 || idlePolicy == IDLE_HOLD) return; // disabled timer if 0, or driver kept on
+    if (!is_disabled && !isBusy() && (halMillis() - lastActivityTimeMs >= idleTimeoutMs)) {
         Serial.println("Motor idle timeout reached — disabling motor.\n");
         disableMotor(); // uses existing function
     }
 }
 
 void MotorController::refreshIdle() {
-    lastActivityTimeMs = millis();
+    lastActivityTimeMs = halMillis();
     if (is_disabled) {
-        digitalWrite(ENABLE_PIN, LOW);
+        halDigitalWrite(ENABLE_PIN, LOW);
         is_disabled = false;
         Serial.println("Motor re-enabled due to activity.\n");
     }
@@ -436,14 +735,62 @@ void MotorController::refreshIdle() {
 
 //* Saving Line Coordinate
 void MotorController::saveLineCoordinate(int line) {
-    if (line < 1 || line > 4) {
-        Serial.println("Invalid line number. Please provide a line between 1 and 4.\n");
+    if (line < 1 || line > KEYPAD_MAX_LINES) {
+        Serial.println("Invalid line number. Please provide a line between 1 and " + String(KEYPAD_MAX_LINES) + ".\n");
         return;
     }
     float currentPos = getCurrentPosition();
     Serial.println("Saving current position for line: " + String(line));
-    setLineCoordinate(line, currentPos);
+    {
+        DeviceConfigLock lock;
+        setLineCoordinate(line, currentPos);
+    }
     Serial.println("Saved current position " + String(currentPos) + " mm as coordinate for line " + String(line) + ".\n");
 }
 
-//! Emergency stop and resume functions -- ADD THIS LATER PLEASE!!!
\ No newline at end of file
+//* EMERGENCY STOP
+// Latches the stop; a running move halts at the next step boundary. Safe to call from ISRs.
+void IRAM_ATTR MotorController::emergencyStop() {
+    if (!is_emergency_stop) {
+        estopTriggerUs = halMicros();
+        estop_was_moving = stepGenerator.isRunning();
+        estop_reported = false;
+    }
+    is_emergency_stop = true;
+    stepGenerator.stop();
+}
+
+bool MotorController::clearEmergencyStop() {
+#ifdef LIMIT_PIN_EMERGENCY
+    if (halDigitalRead(LIMIT_PIN_EMERGENCY) == LOW) {
+        Serial.println("Emergency switch still pressed. Cannot resume.\n");
+        return false;
+    }
+#endif
+    if (!is_emergency_stop) return true;
+
+    is_emergency_stop = false;
+    Serial.println("Emergency stop cleared. Motion resumed.\n");
+    return true;
+}
+
+void MotorController::reportEmergencyStop() {
+    if (estop_reported || stepGenerator.isRunning()) return;
+    estop_reported = true;
+
+    // Trigger-to-halt time, measured between the trigger and the last pulse edge
+    lastStopLatencyUs = estop_was_moving ? stepGenerator.getStoppedAtUs() - estopTriggerUs : 0;
+    Serial.println("Emergency stop latched (halt latency " + String(lastStopLatencyUs) + " us).\n");
+}
+
+void IRAM_ATTR MotorController::_onLimitTop() {
+    if (_instance && !_instance->stepGenerator.isMovingDown()) _instance->stepGenerator.stopAtLimit();
+}
+
+void IRAM_ATTR MotorController::_onLimitBottom() {
+    if (_instance && _instance->stepGenerator.isMovingDown()) _instance->stepGenerator.stopAtLimit();
+}
+
+void IRAM_ATTR MotorController::_onEmergencyPin() {
+    if (_instance) _instance->emergencyStop();
+}
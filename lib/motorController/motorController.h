@@ -2,50 +2,177 @@
 #define MOTOR_CONTROLLER_H
 
 #include <Arduino.h>
-#include <ESP32Servo.h>
+#include <climits>
+#include "hal.h"
 #include "motorConfig.h"
+#include "stepGenerator.h"
+#include "motionPlanner.h"
+#include "servoEngine.h"
+#include "stepPosition.h"
 #include "deviceConfig.h"
 
+enum MotionStatus {
+    MOTION_IDLE,    // Nothing has run yet
+    MOTION_BUSY,
+    MOTION_DONE,
+    MOTION_FAILED,
+};
+
+// What idle timeout does to the driver and to the trusted position
+enum IdlePolicy {
+    IDLE_RELEASE,           // Driver off, position lost (re-home on next move)
+    IDLE_RELEASE_TRUSTED,   // Driver off, position kept: opt-in, only where the carriage cannot drift unpowered
+    IDLE_HOLD,              // Driver stays on, position kept
+};
+
+// Called from update() when an async operation completes or fails
+typedef void (*MotionCallback)(MotionStatus status);
+
 class MotorController {
 public:
     MotorController();
     void setIdleTimeout(unsigned long ms);
     unsigned long getIdleTimeout() const { return idleTimeoutMs; }
     void setSpeed(int speed);
-    int getSpeed() const { return (1000000 / (speedDelay * STEPS_PER_MM)) / 2; } // Returns speed in mm/s
+    int getSpeed() const { return lround(planner.getProfile().cruiseSpeed); } // Returns cruise speed in mm/s
+    void setMotionProfile(float cruiseSpeed, float acceleration, float jerk);
+    unsigned long estimateMoveUs(long steps) const { return planner.estimateMoveUs(steps); }
     void setMaximumPosition(float max_y);
-    float getMaximumPosition() const { return yMaximumPosition / STEPS_PER_MM; } // Returns max position in mm
-    float getCurrentPosition() const { return yPosition / STEPS_PER_MM; } // Returns current position in mm
+    float getMaximumPosition() const { return stepsToMm(yMaximumPosition); } // Returns max position in mm
+    float getCurrentPosition() const { return stepsToMm(getPositionSteps()); } // Returns live position in mm
+    steps_t getPositionSteps() const;
     bool getMotorStatus() const { return !is_disabled; }
+    bool isBusy() const { return state != STATE_IDLE; }
+    MotionStatus getMotionStatus() const { return lastStatus; }
 
     void setup();
     long stepMotor(bool move_down, long steps);
     void disableMotor();
+
+    // Blocking API: starts the async operation and runs update() until it finishes
     bool calibrate();
     void moveTo(float y);
     void moveBy(float dy);
     void pressButton(int num_servo);
     void pressSpecificButton(int button);
 
+    // Async API: returns at once (false if rejected), progress is driven by update()
+    bool calibrateAsync(MotionCallback cb = nullptr);
+    bool moveToAsync(float y, MotionCallback cb = nullptr);
+    bool moveByAsync(float dy, MotionCallback cb = nullptr);
+    bool moveToStepsAsync(steps_t yTargetPosition, MotionCallback cb = nullptr);
+    // Completes once the plunger is clear of the keypad; the servo finishes returning in the background
+    bool pressAsync(int num_servo, MotionCallback cb = nullptr);
+    bool pressKeyAsync(const KeyBinding& key, MotionCallback cb = nullptr); // Press in place, with the key's press profile
+    bool pressSpecificButtonAsync(int button, MotionCallback cb = nullptr);
+    const KeyBinding* resolveButton(int button, steps_t& yTargetPosition) const; // nullptr if unknown or line not set
+    void update();
+    MotionStatus waitForIdle();
+
     void checkIdle();
     void refreshIdle();
 
+    void setIdlePolicy(IdlePolicy policy, unsigned long rehomeIntervalMs);
+    bool needsHoming() const;
+
+    void IRAM_ATTR emergencyStop();
+    bool clearEmergencyStop();
+    bool isEmergencyStopped() const { return is_emergency_stop; }
+    unsigned long getLastStopLatencyUs() const { return lastStopLatencyUs; }
+
+    void setHomingLimits(float maxTravelMm, unsigned long timeoutMs);
+    unsigned long getHomingDurationMs() const { return homingDurationMs; }
+    long getHomingRepeatability() const { return homingRepeatabilitySteps; } // Steps between fast and slow trigger
+
     void saveLineCoordinate(int line);
 
+#if APTL_MOTION_STATS
+    const MotionStats& getStats() const { return stats; }
+    void resetStats() { stats.reset(); }
+#endif
+
+    bool setServoProfile(int num_servo, const ServoProfile& profile);
+    const ServoProfile* getServoProfile(int num_servo) const { return servos.getProfile(num_servo); }
+
 private:
-    Servo servo_left;
-    Servo servo_middle;
-    Servo servo_right;
+    ServoEngine servos;
+    StepGenerator stepGenerator;
+    MotionPlanner planner;
+
+    enum MotionState {
+        STATE_IDLE,
+        STATE_HOMING_FAST,
+        STATE_HOMING_BACKOFF,
+        STATE_HOMING_SLOW,
+        STATE_HOMING_CLEAR,
+        STATE_MOVING,
+        STATE_SETTLING,
+        STATE_PRESS_WAIT, // Servo still returning from its previous press
+        STATE_PRESSING,
+    };
+
+    bool beginMove(steps_t yTargetPosition, const KeyBinding* pressAfter, MotionCallback cb);
+    void startHoming();
+    bool homingAborted();
+    void failHoming(const char* reason);
+    bool startSteps(bool move_down, long steps, MotionState nextState, uint32_t halfPeriodUs = 0); // 0 = ramped
+    void commitSteps();
+    void continueChain();
+    void startPress(const KeyBinding& key);
+    void settle(unsigned long ms);
+    MOTION_STATS(void beginOperation(MotionOp op);)
+    void finish(MotionStatus status);
+    void reportEmergencyStop();
+    void retainPosition(bool moving);
+    bool restoreRetainedPosition();
+
+    static MotorController* _instance;
+    static void IRAM_ATTR _onLimitTop();
+    static void IRAM_ATTR _onLimitBottom();
+    static void IRAM_ATTR _onEmergencyPin();
 
-    int speedDelay;
-    float yPosition;
-    float yMaximumPosition;
+    steps_t yPosition;        // Committed position, updated when a move ends
+    steps_t yMaximumPosition; // 0 = not set
     bool is_calibrated;
-    bool is_emergency_stop;
+    volatile bool is_emergency_stop;
     bool is_disabled;
 
     volatile unsigned long lastActivityTimeMs;
     unsigned long idleTimeoutMs;
+
+    MotionState state;
+    MotionStatus lastStatus;
+    MotionCallback callback;
+    unsigned long phaseEndMs;
+    steps_t pendingTarget; // Step target to move to next, -1 = none
+    KeyBinding pendingKey; // Key to press after the move, servo 0 = none
+    KeyBinding activeKey;
+    long lastRequestedSteps;
+    long lastMovedSteps;
+    bool steps_in_flight;
+
+    volatile unsigned long estopTriggerUs;
+    unsigned long lastStopLatencyUs;
+    volatile bool estop_was_moving;
+    volatile bool estop_reported;
+
+    steps_t homingMaxTravelSteps;
+    unsigned long homingTimeoutMs;
+    uint32_t homingFastHalfPeriodUs;
+    uint32_t homingSlowHalfPeriodUs;
+    unsigned long homingStartMs;
+    unsigned long homingDurationMs;
+    long homingRepeatabilitySteps;
+
+    IdlePolicy idlePolicy;
+    unsigned long rehomeIntervalMs; // Forced re-home interval, 0 = only when trust is lost
+    unsigned long lastHomedMs;
+
+#if APTL_MOTION_STATS
+    MotionStats stats;
+    MotionOp opKind = OP_MOVE; // Operation timed from its async start to finish()
+    unsigned long opStartMs = 0;
+#endif
 };
 
 #endif
\ No newline at end of file
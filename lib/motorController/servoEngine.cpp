@@ -0,0 +1,107 @@
+#include "servoEngine.h"
+
+static const int servoPins[SERVO_COUNT] = {SERVO_LEFT_PIN, SERVO_MIDDLE_PIN, SERVO_RIGHT_PIN};
+
+ServoEngine::ServoEngine() {
+    const ServoProfile defaults = {SERVO_HOVER_ANGLE, SERVO_PRESS_ANGLE, SERVO_PRESS_DURATION,
+                                   SERVO_HOLD_DURATION, SERVO_RELEASE_DURATION, SERVO_RELEASE_CLEAR_MS};
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        channels[i].profile = defaults;
+        channels[i].phase = SERVO_IDLE;
+        channels[i].phaseStartMs = 0;
+        channels[i].holdMs = defaults.holdMs;
+    }
+}
+
+void ServoEngine::begin() {
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        channels[i].servo.attach(servoPins[i]);
+        channels[i].servo.write(channels[i].profile.hoverAngle);
+    }
+}
+
+bool ServoEngine::press(int num_servo, uint8_t pressAngle, uint16_t holdMs) {
+    if (!isIdle(num_servo)) return false;
+    Channel& ch = channels[num_servo - 1];
+    ch.holdMs = holdMs ? holdMs : ch.profile.holdMs;
+    ch.servo.write(pressAngle ? pressAngle : ch.profile.pressAngle);
+    enter(ch, SERVO_PRESSING, halMillis());
+    return true;
+}
+
+void ServoEngine::releaseAll() {
+    unsigned long now = halMillis();
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        Channel& ch = channels[i];
+        if (ch.phase == SERVO_PRESSING || ch.phase == SERVO_HOLDING) {
+            ch.servo.write(ch.profile.hoverAngle);
+            enter(ch, SERVO_RELEASING, now);
+        }
+    }
+}
+
+// Phases are chained from their scheduled end rather than from `now`, so a late
+// update() does not stretch the next phase. Zero-length phases fall through.
+void ServoEngine::update() {
+    unsigned long now = halMillis();
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        Channel& ch = channels[i];
+        bool advanced = true;
+        while (advanced) {
+            unsigned long elapsed = now - ch.phaseStartMs;
+            advanced = false;
+            switch (ch.phase) {
+                case SERVO_PRESSING:
+                    if (elapsed < ch.profile.pressMs) break;
+                    enter(ch, SERVO_HOLDING, ch.phaseStartMs + ch.profile.pressMs);
+                    advanced = true;
+                    break;
+                case SERVO_HOLDING:
+                    if (elapsed < ch.holdMs) break;
+                    ch.servo.write(ch.profile.hoverAngle);
+                    enter(ch, SERVO_RELEASING, ch.phaseStartMs + ch.holdMs);
+                    advanced = true;
+                    break;
+                case SERVO_RELEASING:
+                    if (elapsed < ch.profile.releaseMs) break;
+                    enter(ch, SERVO_IDLE, ch.phaseStartMs + ch.profile.releaseMs);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+void ServoEngine::enter(Channel& ch, ServoPhase phase, unsigned long now) {
+    ch.phase = phase;
+    ch.phaseStartMs = now;
+}
+
+bool ServoEngine::isClear(int num_servo) const {
+    if (!isValid(num_servo)) return false;
+    const Channel& ch = channels[num_servo - 1];
+    if (ch.phase == SERVO_IDLE) return true;
+    return ch.phase == SERVO_RELEASING && halMillis() - ch.phaseStartMs >= ch.profile.clearMs;
+}
+
+bool ServoEngine::allClear() const {
+    for (int i = 1; i <= SERVO_COUNT; i++) {
+        if (!isClear(i)) return false;
+    }
+    return true;
+}
+
+bool ServoEngine::setProfile(int num_servo, const ServoProfile& profile) {
+    if (!isValid(num_servo) || profile.clearMs > profile.releaseMs || profile.pressAngle > 180 || profile.hoverAngle > 180) {
+        return false;
+    }
+    Channel& ch = channels[num_servo - 1];
+    ch.profile = profile;
+    if (ch.phase == SERVO_IDLE) ch.servo.write(profile.hoverAngle);
+    return true;
+}
+
+const ServoProfile* ServoEngine::getProfile(int num_servo) const {
+    return isValid(num_servo) ? &channels[num_servo - 1].profile : nullptr;
+}
@@ -0,0 +1,60 @@
+#ifndef SERVO_ENGINE_H
+#define SERVO_ENGINE_H
+
+#include <Arduino.h>
+#include "hal.h"
+#include "motorConfig.h"
+
+struct ServoProfile {
+    uint8_t hoverAngle;
+    uint8_t pressAngle;
+    uint16_t pressMs;   // hover -> key
+    uint16_t holdMs;    // dwell on the key
+    uint16_t releaseMs; // key -> hover, servo can press again afterwards
+    uint16_t clearMs;   // after release, plunger is off the keypad (carriage may move)
+};
+
+enum ServoPhase : uint8_t {
+    SERVO_IDLE,
+    SERVO_PRESSING,
+    SERVO_HOLDING,
+    SERVO_RELEASING,
+};
+
+// Runs press, hold and release of every servo as timed phases in the background,
+// so a servo can still be returning while the carriage moves or a neighbour presses.
+// Servos are numbered 1 (left) to SERVO_COUNT (right).
+class ServoEngine {
+public:
+    ServoEngine();
+    void begin();
+    void update();
+
+    // false if invalid or still busy with its last press. pressAngle / holdMs override
+    // the profile for this press only, 0 = profile value
+    bool press(int num_servo, uint8_t pressAngle = 0, uint16_t holdMs = 0);
+    void releaseAll();         // Sends every servo back to hover at once (emergency stop)
+
+    bool setProfile(int num_servo, const ServoProfile& profile);
+    const ServoProfile* getProfile(int num_servo) const;
+
+    bool isValid(int num_servo) const { return num_servo >= 1 && num_servo <= SERVO_COUNT; }
+    bool isIdle(int num_servo) const { return isValid(num_servo) && channels[num_servo - 1].phase == SERVO_IDLE; }
+    bool isClear(int num_servo) const;
+    bool allClear() const;
+
+private:
+    struct Channel {
+        HalServo servo;
+        ServoProfile profile;
+        ServoPhase phase;
+        unsigned long phaseStartMs;
+        uint16_t holdMs; // Hold time of the running press
+    };
+
+    Channel channels[SERVO_COUNT];
+
+    void enter(Channel& ch, ServoPhase phase, unsigned long now);
+};
+
+#endif
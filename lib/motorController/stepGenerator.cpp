@@ -0,0 +1,105 @@
+#include "stepGenerator.h"
+#include "fastGpio.h"
+
+StepGenerator* StepGenerator::_instance = nullptr;
+
+StepGenerator::StepGenerator()
+    : stepsDone(0), targetSteps(0),
+    ramp(nullptr), rampLength(0), cruiseHalfPeriodUs(0), lastHalfPeriodUs(0), stopPin(-1),
+    move_down(false), pin_high(false), running(false),
+    stop_requested(false), stopped_by_pin(false), startedAtUs(0), stoppedAtUs(0) {
+    _instance = this;
+    MOTION_STATS(stats = nullptr;)
+}
+
+void StepGenerator::begin() {
+    timer.begin(STEP_TIMER_NUM, &StepGenerator::onTimer);
+}
+
+bool StepGenerator::start(bool move_down, long steps, uint32_t halfPeriodUs, int stopPin) {
+    return startRamped(move_down, steps, nullptr, 0, halfPeriodUs, stopPin);
+}
+
+bool StepGenerator::startRamped(bool move_down, long steps, const uint16_t* ramp, uint16_t rampLength,
+                                uint32_t cruiseHalfPeriodUs, int stopPin) {
+    if (!timer.isReady() || running || steps <= 0) return false;
+
+    if (cruiseHalfPeriodUs < STEP_MIN_HALF_PERIOD_US) cruiseHalfPeriodUs = STEP_MIN_HALF_PERIOD_US;
+    if (!ramp) rampLength = 0;
+
+    this->move_down = move_down;
+    this->stopPin = stopPin;
+    this->ramp = ramp;
+    this->rampLength = rampLength;
+    this->cruiseHalfPeriodUs = cruiseHalfPeriodUs;
+    targetSteps = steps;
+    stepsDone.store(0);
+    pin_high = false;
+    stop_requested = false;
+    stopped_by_pin = false;
+    running = true;
+    MOTION_STATS(if (stats) stats->startPulses();)
+
+    StepPin::low();
+    startedAtUs = halMicros();
+    lastHalfPeriodUs = rampLength ? ramp[0] : cruiseHalfPeriodUs;
+    timer.start(lastHalfPeriodUs);
+    return true;
+}
+
+void IRAM_ATTR StepGenerator::stop() {
+    stop_requested = true;
+}
+
+void IRAM_ATTR StepGenerator::stopAtLimit() {
+    if (!running) return;
+    stopped_by_pin = true;
+    stop_requested = true;
+}
+
+void IRAM_ATTR StepGenerator::finishFromISR() {
+    timer.stop();
+    stoppedAtUs = halMicros();
+    running = false;
+}
+
+void IRAM_ATTR StepGenerator::onTimer() {
+    StepGenerator* g = _instance;
+    if (!g || !g->running) return;
+
+    if (g->pin_high) {
+        // Falling edge completes the step
+        StepPin::low();
+        g->pin_high = false;
+        long done = g->stepsDone.load() + 1;
+        g->stepsDone.store(done);
+        if (done >= g->targetSteps) g->finishFromISR();
+        return;
+    }
+
+    // Step boundary: abort checks happen here so a pulse is never cut short
+    if (g->stop_requested) {
+        g->finishFromISR();
+        return;
+    }
+    if (g->stopPin >= 0 && !fastDigitalRead(g->stopPin)) {
+        g->stopped_by_pin = true;
+        g->finishFromISR();
+        return;
+    }
+
+    // Interval for this step: ramp up, cruise, then ramp down mirrored from the end
+    long done = g->stepsDone.load();
+    uint32_t halfPeriod = g->cruiseHalfPeriodUs;
+    if (g->rampLength) {
+        long fromEnd = g->targetSteps - 1 - done;
+        long idx = (done < fromEnd) ? done : fromEnd;
+        if (idx < g->rampLength) halfPeriod = g->ramp[idx];
+    }
+    g->timer.setAlarm(halfPeriod);
+    g->lastHalfPeriodUs = halfPeriod;
+    MOTION_STATS(if (g->stats) g->stats->recordEdge(halfPeriod);)
+
+    StepPin::high();
+    g->pin_high = true;
+}
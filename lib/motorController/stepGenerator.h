@@ -0,0 +1,62 @@
+#ifndef STEP_GENERATOR_H
+#define STEP_GENERATOR_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "hal.h"
+#include "motorConfig.h"
+#include "motionStats.h"
+
+// Background step pulse generator driven by the HAL step timer (an ESP32 hardware timer).
+// Every timer alarm toggles STEP_PIN, so one step = one high half + one low half.
+// A running move can be stopped, but only at a step boundary (never mid-pulse).
+class StepGenerator {
+public:
+    StepGenerator();
+    void begin();
+
+    // Starts a pulse train in the background. Returns false if already running.
+    // stopPin (optional) ends the move when it reads LOW, checked before every step.
+    bool start(bool move_down, long steps, uint32_t halfPeriodUs, int stopPin = -1);
+
+    // Same, but accelerates through `ramp` (half-periods in us), cruises, and
+    // decelerates through the ramp in reverse. The table must outlive the move.
+    bool startRamped(bool move_down, long steps, const uint16_t* ramp, uint16_t rampLength,
+                     uint32_t cruiseHalfPeriodUs, int stopPin = -1);
+    void IRAM_ATTR stop(); // safe to call from ISRs
+    void IRAM_ATTR stopAtLimit(); // same, but flags the move as ended by a limit switch
+
+    bool isRunning() const { return running; }
+    long getStepsDone() const { return stepsDone.load(); }
+    bool stoppedByPin() const { return stopped_by_pin; }
+    bool isMovingDown() const { return move_down; }
+    unsigned long getStartedAtUs() const { return startedAtUs; } // halMicros() when the last move started
+    unsigned long getStoppedAtUs() const { return stoppedAtUs; } // halMicros() when the last move ended
+    uint32_t getLastHalfPeriodUs() const { return lastHalfPeriodUs; } // Of the last step: the speed a move ended at
+    MOTION_STATS(void setStats(MotionStats* stats) { this->stats = stats; })
+
+private:
+    static void IRAM_ATTR onTimer();
+    void IRAM_ATTR finishFromISR();
+
+    static StepGenerator* _instance;
+    HalStepTimer timer;
+
+    std::atomic<long> stepsDone;
+    volatile long targetSteps;
+    const uint16_t* volatile ramp;
+    volatile uint16_t rampLength;
+    volatile uint32_t cruiseHalfPeriodUs;
+    volatile uint32_t lastHalfPeriodUs;
+    volatile int stopPin;
+    volatile bool move_down;
+    volatile bool pin_high;
+    volatile bool running;
+    volatile bool stop_requested;
+    volatile bool stopped_by_pin;
+    volatile unsigned long startedAtUs;
+    volatile unsigned long stoppedAtUs;
+    MOTION_STATS(MotionStats* stats;)
+};
+
+#endif
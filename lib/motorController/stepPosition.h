@@ -0,0 +1,32 @@
+#ifndef STEP_POSITION_H
+#define STEP_POSITION_H
+
+#include <stdint.h>
+#include "motorConfig.h"
+
+// Carriage positions and distances are kept in whole motor (micro)steps; millimetres
+// only appear at the API boundary (MQTT, config, logs)
+typedef int32_t steps_t;
+
+// Drive train from motorConfig.h as an exact integer ratio: steps per revolution
+// over belt travel per revolution in micrometres
+constexpr int32_t STEPS_PER_DRIVE_REV = STEPS_PER_REV * MICROSTEPS;
+constexpr int32_t UM_PER_DRIVE_REV = (int32_t)(PULLEY_TEETH * BELT_PITCH * 1000.0 + 0.5);
+static_assert(STEPS_PER_DRIVE_REV > 0 && UM_PER_DRIVE_REV > 0, "Invalid drive train in motorConfig.h");
+
+// Rounds to the nearest step, halves away from zero
+constexpr steps_t umToSteps(int32_t um) {
+    return (steps_t)(((int64_t)um * STEPS_PER_DRIVE_REV + (um >= 0 ? UM_PER_DRIVE_REV / 2 : -(UM_PER_DRIVE_REV / 2))) /
+                     UM_PER_DRIVE_REV);
+}
+
+// mm values outside this range (and NaN / inf) cannot be converted
+constexpr float MM_CONVERTIBLE_LIMIT = 100000.0f;
+constexpr bool mmConvertible(float mm) { return mm > -MM_CONVERTIBLE_LIMIT && mm < MM_CONVERTIBLE_LIMIT; }
+
+constexpr steps_t mmToSteps(float mm) { return umToSteps((int32_t)(mm * 1000.0f + (mm >= 0 ? 0.5f : -0.5f))); }
+constexpr float stepsToMm(steps_t steps) { return (float)((int64_t)steps * UM_PER_DRIVE_REV) / STEPS_PER_DRIVE_REV / 1000.0f; }
+
+constexpr steps_t MAX_POSITION_STEPS = mmToSteps(MAX_POSITION_LIMIT);
+
+#endif // STEP_POSITION_H
@@ -0,0 +1,80 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#define COMMAND_QUEUE_SIZE 16 // Must be a power of two
+#define COMMAND_TEXT_SIZE 48  // Kodetoken, including the terminator
+
+enum CommandType : uint8_t {
+    CMD_STOP,
+    CMD_RESUME,
+    CMD_HOME,
+    CMD_UP,
+    CMD_DOWN,
+    CMD_PRESS,    // arg = servo
+    CMD_SET_MAX,
+    CMD_SET_ROW,  // arg = line
+    CMD_TOKEN,
+    CMD_MOVE_TO,      // value = target in steps
+    CMD_MOVE_BY,      // value = distance in steps
+    CMD_PRESS_BUTTON, // arg = keypad button
+    CMD_SET_LAYOUT,   // layout waiting in MqttManager, see onKeypad()
+};
+
+struct Command {
+    CommandType type;
+    uint8_t arg;
+    int32_t value;
+    uint32_t rpcId;                // Non-zero: answer on rpc/response/<rpcId> when done
+    unsigned long receivedMs;
+    char text[COMMAND_TEXT_SIZE];  // CMD_TOKEN: kodetoken
+};
+
+// Bounded single-producer / single-consumer ring of Command records.
+// The producer (MQTT callback, network task) fills a slot in place with reserve()/commit(),
+// the consumer (command executor, motion task) reads it with peek()/pop(). Nothing is
+// allocated and no lock is taken; a full queue refuses the record and counts it as dropped.
+class CommandQueue {
+public:
+    CommandQueue() : head(0), tail(0), dropped(0), highWater(0) {}
+
+    // Producer side
+    Command* reserve() {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= COMMAND_QUEUE_SIZE) {
+            dropped++;
+            return nullptr;
+        }
+        return &slots[h & (COMMAND_QUEUE_SIZE - 1)];
+    }
+    void reject() { dropped++; } // Record refused before reserve(), e.g. text too long
+    void commit() {
+        uint32_t h = head.load(std::memory_order_relaxed) + 1;
+        head.store(h, std::memory_order_release);
+        uint32_t depth = h - tail.load(std::memory_order_acquire);
+        if (depth > highWater) highWater = depth;
+    }
+
+    // Consumer side
+    const Command* peek() const {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return nullptr;
+        return &slots[t & (COMMAND_QUEUE_SIZE - 1)];
+    }
+    void pop() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    uint32_t depth() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    uint32_t getDropped() const { return dropped; }
+    uint32_t getHighWater() const { return highWater; }
+
+private:
+    Command slots[COMMAND_QUEUE_SIZE];
+    std::atomic<uint32_t> head; // Next slot to write, only advanced by the producer
+    std::atomic<uint32_t> tail; // Next slot to read, only advanced by the consumer
+    volatile uint32_t dropped;
+    volatile uint32_t highWater;
+};
+
+#endif // COMMAND_QUEUE_H
@@ -1,5 +1,7 @@
 #include "mqttManager.h"
 
+#include <sys/time.h>
+
 #include "../wifiManager/wifiManager.h"
 #include "../fsManager/fsManager.h"
 #include "../motorController/motorController.h"
@@ -13,6 +15,8 @@ MqttManager* MqttManager::_instance = nullptr;
 
 MqttManager::MqttManager() {
     _instance = this;
+    _statusQueue = xQueueCreate(STATUS_QUEUE_SIZE, sizeof(int));
+    _rpcQueue = xQueueCreate(RPC_QUEUE_SIZE, sizeof(RpcResult));
 }
 
 void MqttManager::init(const IPAddress& broker, uint16_t port, const String& clientId, const char* user, const char* pass) {
@@ -21,361 +25,894 @@ void MqttManager::init(const IPAddress& broker, uint16_t port, const String& cli
     _clientId = clientId.length() ? clientId : "aptl-device";
     _user = user;
     _pass = pass;
-    _client.setServer(_broker, _port);
-    _client.setCallback(MqttManager::_internalCallback);
-    _client.setSocketTimeout(5);
-    _client.setKeepAlive(60);
+    if (!_client->begin(_broker, _port, MQTT_BUFFER_SIZE, MQTT_KEEPALIVE_S, MQTT_SOCKET_TIMEOUT_S,
+                        MqttManager::_internalCallback)) {
+        Serial.printf("[mqtt] Could not allocate a %u byte MQTT buffer\n", (unsigned)MQTT_BUFFER_SIZE);
+    }
+    buildAttrFilter();
+    halStartTimeSync(TELEMETRY_NTP_SERVER); // Telemetry timestamps, UTC
+    journal.begin();
+    _initialised = true;
 }
 
 void MqttManager::connect() {
-    if (WiFi.status() != WL_CONNECTED) return;
-    if (_client.connected()) return;
-
-    Serial.printf("[mqtt] Connecting to MQTT %s:%u ..\n", _broker.toString().c_str(), _port);
-    unsigned long start = millis();
-    while (!_client.connected()) {
-        bool ok;
-        if (_user && strlen(_user)) ok = _client.connect(_clientId.c_str(), _user, _pass);
-        else ok = _client.connect(_clientId.c_str());
-        
-        if (ok) {
-            Serial.println("[mqtt] connected succesfully.");
-            _client.subscribe(_instance->TOPIC_RESP);
-            _client.subscribe(_instance->TOPIC_PUSH);
-            _instance->requestShared();
-            break;
-        } else {
-            Serial.printf("[mqtt] connect failed, rc=%d. retrying in 5s\n", _client.state());
-            delay(5000);
-        }
-        // optional safety timeout (avoid infinite block on WiFi lost)
-        if (millis() - start > 30000) break;
-    }
+    _nextAttemptMs = halMillis();
 }
 
 void MqttManager::loop() {
-    if (_client.connected()) {
-        _client.loop();
-    }
+    serviceConnection();
+    if (_client->connected()) {
+        _client->poll();
+    }
+    serviceAttributes();
+    publishQueuedStatus();
+    publishRpcResults();
+    applyWifiChange();
+    flushTelemetry();
+    replayJournal();
 }
 
-void MqttManager::requestShared() {
-  const char* keys = "kodetoken,home,up,down,press1,press2,press3,stop,setmax,row1,row2,row3,row4,newssid,newpass";
-  char payload[128];
-  snprintf(payload, sizeof(payload), "{\"sharedKeys\":\"%s\"}", keys);
-  _client.publish(_instance->TOPIC_REQ, payload);
+//* CONNECTION
+// Never waits: between attempts this returns right away, an attempt itself is bounded
+// by the TCP connect timeout and MQTT_SOCKET_TIMEOUT_S
+void MqttManager::serviceConnection() {
+    unsigned long now = halMillis();
+    if (_client->connected()) return;
+
+    if (_connState == CONN_CONNECTED) {
+        _connState = CONN_WAITING;
+        _disconnects++;
+        _backoffMs = 0;
+        _nextAttemptMs = now;
+        Serial.printf("[mqtt] connection lost, rc=%d (%u disconnects)\n", _client->state(), (unsigned)_disconnects);
+    }
+
+    if (!_initialised || halWiFi().status() != WL_CONNECTED) return;
+    if ((long)(now - _nextAttemptMs) < 0) return;
+    attemptConnect(now);
 }
 
-void MqttManager::applyShared(JsonVariant root) {
-    // incoming payload can be either { "shared": { ... } } or just { ... }
-    JsonVariant shared = root["shared"];
-    JsonVariant obj    = shared.isNull() ? root : shared;
+void MqttManager::attemptConnect(unsigned long now) {
+    _connectAttempts++;
+    Serial.printf("[mqtt] Connecting to MQTT %s:%u (attempt %u) ..\n", _broker.toString().c_str(), _port, (unsigned)_connectAttempts);
 
-    bool changed = false;
+    bool ok = _client->connect(_clientId.c_str(), _user, _pass);
+    unsigned long took = halMillis() - now;
 
-    if (obj["kodetoken"].is<String>()) {
-        String nv = obj["kodetoken"].as<String>();
-        if (nv != kodetoken) { kodetoken = nv; changed = true; }
+    if (ok) {
+        _connectLatencyMs = took;
+        onConnected();
+        return;
     }
 
-    if (obj["home"].is<int>()) {
-        int nv = obj["home"].as<int>();
-        if (nv != home) { home = nv; changed = true; }
-    }
+    // Jittered exponential backoff: wait a random time in [backoff / 2, backoff]
+    _connectFailures++;
+    _backoffMs = _backoffMs ? _backoffMs * 2 : MQTT_BACKOFF_MIN_MS;
+    if (_backoffMs > MQTT_BACKOFF_MAX_MS) _backoffMs = MQTT_BACKOFF_MAX_MS;
+    unsigned long wait = _backoffMs / 2 + random(_backoffMs / 2 + 1);
+    _nextAttemptMs = halMillis() + wait;
+    Serial.printf("[mqtt] connect failed after %lu ms, rc=%d. retrying in %lu ms\n", took, _client->state(), wait);
+}
 
-    if (obj["up"].is<int>()) {
-        int nv = obj["up"].as<int>();
-        if (nv != up) { up = nv; changed = true; }
-    }
+void MqttManager::onConnected() {
+    _connState = CONN_CONNECTED;
+    _backoffMs = 0;
+    Serial.printf("[mqtt] connected succesfully in %lu ms.\n", _connectLatencyMs);
+    _client->subscribe(TOPIC_RESP);
+    _client->subscribe(TOPIC_PUSH);
+    _client->subscribe(TOPIC_RPC);
+
+    // Pushes may have been missed while offline
+    _uncertainAttrs = 0;
+    for (uint8_t i = 0; i < SHARED_ATTR_COUNT; i++) {
+        if (SHARED_ATTRS[i].requested) _uncertainAttrs |= 1UL << i;
+    }
+    _attrPendingMask = 0;
+    requestShared();
+    telemetry.requestFull();
+}
 
-    if (obj["down"].is<int>()) {
-        int nv = obj["down"].as<int>();
-        if (nv != down) { down = nv; changed = true; }
+void MqttManager::publishQueuedStatus() {
+    int status;
+    bool any = false;
+    while (xQueueReceive(_statusQueue, &status, 0) == pdTRUE) {
+        statusaptl = status;
+        sampleTelemetry(); // One sample per status, so transitions inside a batch are kept
+        any = true;
     }
+    if (any) flushTelemetry();
+}
 
-    if (obj["press1"].is<int>()) {
-        int nv = obj["press1"].as<int>();
-        if (nv != press1) { press1 = nv; changed = true; }
-    }
-  
-    if (obj["press2"].is<int>()) {
-        int nv = obj["press2"].as<int>();
-        if (nv != press2) { press2 = nv; changed = true; }
-    }
+// Applied here rather than in the attribute callback, which runs inside the transport poll
+void MqttManager::applyWifiChange() {
+    if (!wifiChangePending) return;
+    wifiChangePending = false;
+    if (getWiFiSSID() == newssid) return;
 
-    if (obj["press3"].is<int>()) {
-        int nv = obj["press3"].as<int>();
-        if (nv != press3) { press3 = nv; changed = true; }
-    }
+    statusaptl = 51; //* Setting WiFi SSID/Password
+    publishTelemetry();
 
-    if (obj["stop"].is<int>()) {
-        int nv = obj["stop"].as<int>();
-        if (nv != stop) { stop = nv; changed = true; }
+    Serial.printf("[mqtt] newssid received: %s\n", newssid);
+    {
+        DeviceConfigLock lock;
+        setWiFiCredentials(newssid, newpass);
+        fsManager.saveConfig();
     }
+    wifiManager.init(getWiFiSSID(), getWiFiPassword());
+    wifiManager.connect();
 
-    if (obj["setmax"].is<int>()) {
-        int nv = obj["setmax"].as<int>();
-        if (nv != setmax) { setmax = nv; changed = true; }
-    }
+    statusaptl = 0; //* Idle
+    publishTelemetry();
+}
 
-    if (obj["row1"].is<int>()) {
-        int nv = obj["row1"].as<int>();
-        if (nv != row1) { row1 = nv; changed = true; }
-    }
+//* SHARED ATTRIBUTES
+// One entry per shared attribute. Edge attributes keep their last value in `slot` and
+// queue `command` on a rising edge (or any change); the rest go to a handler.
+#define ATTR_KEY(k) k, sizeof(k) - 1
+const MqttManager::SharedAttr MqttManager::SHARED_ATTRS[] = {
+    {ATTR_KEY("stop"),      ATTR_HANDLER,   true,  nullptr,               CMD_STOP,    0, &MqttManager::onStop},
+    {ATTR_KEY("home"),      ATTR_RISING,    true,  &MqttManager::home,    CMD_HOME,    0, nullptr},
+    {ATTR_KEY("up"),        ATTR_RISING,    true,  &MqttManager::up,      CMD_UP,      0, nullptr},
+    {ATTR_KEY("down"),      ATTR_RISING,    true,  &MqttManager::down,    CMD_DOWN,    0, nullptr},
+    {ATTR_KEY("press1"),    ATTR_RISING,    true,  &MqttManager::press1,  CMD_PRESS,   1, nullptr},
+    {ATTR_KEY("press2"),    ATTR_RISING,    true,  &MqttManager::press2,  CMD_PRESS,   2, nullptr},
+    {ATTR_KEY("press3"),    ATTR_RISING,    true,  &MqttManager::press3,  CMD_PRESS,   3, nullptr},
+    {ATTR_KEY("setmax"),    ATTR_RISING,    true,  &MqttManager::setmax,  CMD_SET_MAX, 0, nullptr},
+    {ATTR_KEY("row1"),      ATTR_CHANGE,    true,  &MqttManager::row1,    CMD_SET_ROW, 1, nullptr},
+    {ATTR_KEY("row2"),      ATTR_CHANGE,    true,  &MqttManager::row2,    CMD_SET_ROW, 2, nullptr},
+    {ATTR_KEY("row3"),      ATTR_CHANGE,    true,  &MqttManager::row3,    CMD_SET_ROW, 3, nullptr},
+    {ATTR_KEY("row4"),      ATTR_CHANGE,    true,  &MqttManager::row4,    CMD_SET_ROW, 4, nullptr},
+    {ATTR_KEY("kodetoken"), ATTR_HANDLER,   true,  nullptr,               CMD_TOKEN,   0, &MqttManager::onKodetoken},
+    {ATTR_KEY("newssid"),   ATTR_HANDLER,   true,  nullptr,               CMD_STOP,    0, &MqttManager::onNewSsid},
+    {ATTR_KEY("newpass"),   ATTR_HANDLER,   true,  nullptr,               CMD_STOP,    0, &MqttManager::onNewPass},
+    {ATTR_KEY("keypad"),    ATTR_HANDLER,   false, nullptr,               CMD_STOP,    0, &MqttManager::onKeypad}, // push only
+};
+#undef ATTR_KEY
+const uint8_t MqttManager::SHARED_ATTR_COUNT = sizeof(SHARED_ATTRS) / sizeof(SHARED_ATTRS[0]);
+
+// Key list for the attribute request is built from the table, uncertain keys only
+void MqttManager::requestShared() {
+  static_assert(sizeof(SHARED_ATTRS) / sizeof(SHARED_ATTRS[0]) <= 32, "Attribute masks hold 32 keys");
+  char payload[192];
+  uint32_t mask = 0;
+  size_t len = strlcpy(payload, "{\"sharedKeys\":\"", sizeof(payload));
+  for (uint8_t i = 0; i < SHARED_ATTR_COUNT; i++) {
+    const SharedAttr& attr = SHARED_ATTRS[i];
+    if (!(_uncertainAttrs & (1UL << i))) continue;
+    if (len + attr.keyLength + 3 >= sizeof(payload)) break; // the rest goes in the next request
+    if (payload[len - 1] != '"') payload[len++] = ',';
+    memcpy(payload + len, attr.key, attr.keyLength);
+    len += attr.keyLength;
+    mask |= 1UL << i;
+  }
+  if (!mask) return;
+  payload[len++] = '"';
+  payload[len++] = '}';
+  payload[len] = '\0';
+
+  char topic[48];
+  uint32_t id = _attrRequestId + 1;
+  snprintf(topic, sizeof(topic), "%s%u", TOPIC_REQ, (unsigned)id);
+  if (!_client->publish(topic, (const uint8_t*)payload, len)) return;
+  _attrRequestId = id;
+  _attrPendingMask = mask;
+  _attrRequestMs = halMillis();
+  Serial.printf("[mqtt] Attribute request %u: %s\n", (unsigned)id, payload);
+}
 
-    if (obj["row2"].is<int>()) {
-        int nv = obj["row2"].as<int>();
-        if (nv != row2) { row2 = nv; changed = true; }
-    }
+// Re-requests while keys are uncertain: the request failed to publish or its response
+// did not arrive within ATTR_REQUEST_TIMEOUT_MS
+void MqttManager::serviceAttributes() {
+  if (!_uncertainAttrs || !_client->connected()) return;
+  if (_attrPendingMask) {
+    if (halMillis() - _attrRequestMs < ATTR_REQUEST_TIMEOUT_MS) return;
+    Serial.printf("[mqtt] Attribute request %u timed out.\n", (unsigned)_attrRequestId);
+    _attrPendingMask = 0;
+  }
+  requestShared();
+}
 
-    if (obj["row3"].is<int>()) {
-        int nv = obj["row3"].as<int>();
-        if (nv != row3) { row3 = nv; changed = true; }
-    }
+// Runs in the MQTT callback: walks the incoming object once and matches each key
+// against the table by length + memcmp. Attribute edges become commands on the queue,
+// so a toggle or a second kodetoken between two executor passes is never lost
+void MqttManager::applyShared(JsonVariantConst root) {
+    // incoming payload can be either { "shared": { ... } } or just { ... }
+    JsonVariantConst shared = root["shared"];
+    JsonObjectConst obj = (shared.isNull() ? root : shared).as<JsonObjectConst>();
+
+    for (JsonPairConst kv : obj) {
+        JsonString key = kv.key();
+        const SharedAttr* attr = nullptr;
+        for (uint8_t i = 0; i < SHARED_ATTR_COUNT; i++) {
+            if (SHARED_ATTRS[i].keyLength == key.size() && memcmp(SHARED_ATTRS[i].key, key.c_str(), key.size()) == 0) {
+                attr = &SHARED_ATTRS[i];
+                break;
+            }
+        }
+        if (!attr) continue;
+        _uncertainAttrs &= ~(1UL << (attr - SHARED_ATTRS));
 
-    if (obj["row4"].is<int>()) {
-        int nv = obj["row4"].as<int>();
-        if (nv != row4) { row4 = nv; changed = true; }
-    }
+        JsonVariantConst value = kv.value();
+        if (attr->kind == ATTR_HANDLER) {
+            (this->*(attr->handler))(value);
+            continue;
+        }
 
-    if (obj["newssid"].is<String>()) {
-        String nv = obj["newssid"].as<String>();
-        if (nv != newssid) { newssid = nv; changed = true; }
+        if (!value.is<int>()) continue;
+        int nv = value.as<int>();
+        int& last = this->*(attr->slot);
+        bool fire = attr->kind == ATTR_RISING ? (nv && !last) : (nv != last);
+        last = nv;
+        if (fire) enqueue(attr->command, attr->arg);
     }
+}
+
+void MqttManager::onStop(JsonVariantConst value) {
+    if (!value.is<int>()) return;
+    int nv = value.as<int>();
+    if (nv == stop) return;
+    stop = nv;
+    // Acted on here, not in processCommands, so the axis halts at its next step
+    if (stop) motorController.emergencyStop();
+    else motorController.clearEmergencyStop();
+    enqueue(stop ? CMD_STOP : CMD_RESUME);
+}
+
+void MqttManager::onKodetoken(JsonVariantConst value) {
+    if (!value.is<const char*>()) return;
+    const char* nv = value.as<const char*>();
+    if (strncmp(nv, kodetoken, sizeof(kodetoken) - 1) == 0) return;
+    strlcpy(kodetoken, nv, sizeof(kodetoken));
+    if (nv[0]) enqueue(CMD_TOKEN, 0, nv);
+}
+
+// Applied from loop() once the whole message is in, so newpass may follow newssid
+void MqttManager::onNewSsid(JsonVariantConst value) {
+    if (!value.is<const char*>()) return;
+    const char* nv = value.as<const char*>();
+    if (strncmp(nv, newssid, sizeof(newssid) - 1) == 0) return;
+    strlcpy(newssid, nv, sizeof(newssid));
+    if (nv[0]) wifiChangePending = true;
+}
+
+void MqttManager::onNewPass(JsonVariantConst value) {
+    if (!value.is<const char*>()) return;
+    strlcpy(newpass, value.as<const char*>(), sizeof(newpass));
+}
 
-    if (obj["newpass"].is<String>()) {
-        String nv = obj["newpass"].as<String>();
-        if (nv != newpass) { newpass = nv; changed = true; }
+// Keypad layout for a different meter model. The motion task reads the layout, so it
+// applies and saves it there, in order with the commands before it
+void MqttManager::onKeypad(JsonVariantConst value) {
+    KeypadLayout layout;
+    if (!FSManager::parseKeypadLayout(value, layout)) {
+        Serial.println("[mqtt] Invalid keypad layout ignored.");
+        return;
+    }
+    {
+        DeviceConfigLock lock;
+        _pendingLayout = layout; // A later push before it is applied replaces it
     }
+    enqueue(CMD_SET_LAYOUT);
+}
+
+// Copies the command into the next free queue slot; a full queue or an oversized
+// text is logged and counted, never dropped silently
+bool MqttManager::enqueue(CommandType type, uint8_t arg, const char* text, int32_t value, uint32_t rpcId) {
+    if (text && strlen(text) >= COMMAND_TEXT_SIZE) {
+        commandQueue.reject();
+        Serial.printf("[mqtt] Command %u dropped: text too long (%u dropped)\n", type, (unsigned)commandQueue.getDropped());
+        return false;
+    }
+
+    Command* cmd = commandQueue.reserve();
+    if (!cmd) {
+        Serial.printf("[mqtt] Command %u dropped: queue full (%u dropped)\n", type, (unsigned)commandQueue.getDropped());
+        return false;
+    }
+    cmd->type = type;
+    cmd->arg = arg;
+    cmd->value = value;
+    cmd->rpcId = rpcId;
+    cmd->receivedMs = halMillis();
+    strlcpy(cmd->text, text ? text : "", sizeof(cmd->text));
+    commandQueue.commit();
+    if (_executorTask) xTaskNotifyGive(_executorTask); // wake the motion task right away
+    return true;
+}
 
-    if (changed) subUpdated = true;
+//* TELEMETRY
+static const time_t TELEMETRY_MIN_EPOCH_S = 1600000000; // Anything earlier: SNTP has not synced yet
+
+const TelemetryKey MqttManager::TELEMETRY_KEYS[] = {
+    {"posisi",      0.5f, false},
+    {"statusaptl",  0,    true},
+    {"estop",       0,    true},
+    {"stoplatency", 0,    false},
+    {"homingms",    0,    false},
+    {"homingrep",   0,    false},
+    {"cmdq",        0,    false},
+    {"cmdqmax",     0,    false},
+    {"cmdqdrop",    0,    false},
+    {"rxparseus",   100,  false},
+    {"rxparsemax",  0,    false},
+    {"rxdrop",      0,    false},
+    {"mqttconn",    0,    false},
+    {"mqttconnms",  0,    false},
+    {"mqttdisc",    0,    false},
+    {"tlmdrop",     0,    false},
+    {"tlmjournal",  256,  false},
+    {"tokens",      0,    false},
+    {"tokenfail",   0,    false},
+    {"mqttinflight", 0,   false},
+    {"mqttretx",    0,    false},
+#if APTL_MOTION_STATS
+    {"jitp99",      2,    false},
+    {"jitmax",      0,    false},
+    {"movesps",     50,   false},
+#endif
+};
+
+static int64_t epochNowMs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec < TELEMETRY_MIN_EPOCH_S) return 0;
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
 }
 
+// Called online or offline; before init() (AP mode) there is no journal to spill to
 void MqttManager::publishTelemetry() {
-  // Siapkan JSON telemetry
+  if (!_initialised) return;
+  sampleTelemetry();
+  flushTelemetry();
+}
+
+void MqttManager::sampleTelemetry() {
+  static_assert(sizeof(TELEMETRY_KEYS) / sizeof(TELEMETRY_KEYS[0]) == TLM_COUNT, "TELEMETRY_KEYS must match TelemetryField");
+  static_assert(TLM_COUNT <= TELEMETRY_MAX_KEYS, "Too many telemetry keys");
   posisi = motorController.getCurrentPosition();
 
-  char payload[192];
-  snprintf(payload, sizeof(payload),
-           "{\"posisi\":%.2f,\"statusaptl\":%d}",
-           posisi, statusaptl);
+  float v[TLM_COUNT];
+  v[TLM_POSISI] = posisi;
+  v[TLM_STATUS] = statusaptl;
+  v[TLM_ESTOP] = motorController.isEmergencyStopped() ? 1 : 0;
+  v[TLM_STOP_LATENCY] = motorController.getLastStopLatencyUs();
+  v[TLM_HOMING_MS] = motorController.getHomingDurationMs();
+  v[TLM_HOMING_REP] = motorController.getHomingRepeatability();
+  v[TLM_CMDQ] = commandQueue.depth();
+  v[TLM_CMDQ_MAX] = commandQueue.getHighWater();
+  v[TLM_CMDQ_DROP] = commandQueue.getDropped();
+  v[TLM_RX_PARSE_US] = _rxParseUs;
+  v[TLM_RX_PARSE_MAX] = _rxParseMaxUs;
+  v[TLM_RX_DROP] = _rxOversize + _rxErrors;
+  v[TLM_MQTT_CONN] = _connectAttempts;
+  v[TLM_MQTT_CONN_MS] = _connectLatencyMs;
+  v[TLM_MQTT_DISC] = _disconnects;
+  v[TLM_TELEMETRY_DROP] = telemetry.getDropped();
+  v[TLM_JOURNAL_BYTES] = journal.pendingBytes();
+  v[TLM_TOKENS] = _tokensDone;
+  v[TLM_TOKEN_FAILS] = _tokensFailed;
+  v[TLM_MQTT_INFLIGHT] = _client->inFlight();
+  v[TLM_MQTT_RETX] = _client->getRetransmits();
+#if APTL_MOTION_STATS
+  // Step timing summary, full histograms via the "stats" serial command
+  const MotionStats& stats = motorController.getStats();
+  v[TLM_JITTER_P99] = stats.getJitterP99Us();
+  v[TLM_JITTER_MAX] = stats.getJitterMaxUs();
+  v[TLM_MOVE_SPS] = stats.getLastMoveSps();
+#endif
+  telemetry.sample(v, halMillis());
+}
+
+// Publishes whole batches while one is due: a status change, TELEMETRY_BATCH_SAMPLES
+// waiting, or the oldest sample older than TELEMETRY_FLUSH_MS
+void MqttManager::flushTelemetry() {
+  if (!_client->connected()) {
+    spillTelemetry();
+    return;
+  }
+
+  unsigned long now = halMillis();
+  while (telemetry.flushDue(now)) {
+    uint8_t payload[MQTT_MAX_PAYLOAD];
+    uint8_t samples;
+    size_t len = telemetry.serialize(payload, sizeof(payload), _encoding[PAYLOAD_TELEMETRY], epochNowMs(), now, samples);
+    if (!samples) { // Cannot happen with the current key set, but never wedge the ring
+      Serial.println("[pub] Telemetry sample too large, dropped.");
+      telemetry.consume(1);
+      continue;
+    }
+
+    bool ok = _client->publish(TOPIC_PUB, payload, len, MQTT_TELEMETRY_QOS);
+    Serial.printf("[pub] %s | %u samples, %u bytes\n", ok ? "OK" : "FAIL", samples, (unsigned)len);
+    if (!ok) {
+      spillTelemetry();
+      break;
+    }
+    telemetry.consume(samples);
+  }
+}
+
+// Offline: whatever would have been published goes to the journal, on the same
+// triggers as a publish, so flash sees one append per batch or status change
+void MqttManager::spillTelemetry() {
+  unsigned long now = halMillis();
+  if (!telemetry.flushDue(now)) return;
+
+  const TelemetrySample* samples[TELEMETRY_RING_SIZE];
+  int64_t ts[TELEMETRY_RING_SIZE];
+  int64_t epoch = epochNowMs();
+  uint8_t count = telemetry.depth();
+  for (uint8_t n = 0; n < count; n++) {
+    samples[n] = &telemetry.peek(n);
+    ts[n] = TelemetryBuffer::sampleEpochMs(*samples[n], epoch, now);
+  }
+  if (journal.append(samples, ts, count)) telemetry.consume(count);
+}
 
-  bool ok = _client.publish(_instance->TOPIC_PUB, payload);
-  Serial.printf("[pub] %s | %s\n", ok ? "OK" : "FAIL", payload);
+// Back online: one batch per JOURNAL_REPLAY_INTERVAL_MS, after live telemetry
+void MqttManager::replayJournal() {
+  if (!_client->connected() || journal.isEmpty()) return;
+  unsigned long now = halMillis();
+  if (telemetry.flushDue(now) || now - _lastReplayMs < JOURNAL_REPLAY_INTERVAL_MS) return;
+  _lastReplayMs = now;
+
+  TelemetrySample samples[JOURNAL_REPLAY_RECORDS];
+  int64_t ts[JOURNAL_REPLAY_RECORDS];
+  uint8_t count = journal.read(samples, ts, JOURNAL_REPLAY_RECORDS, epochNowMs(), now);
+  if (!count) return;
+
+  const TelemetrySample* batch[JOURNAL_REPLAY_RECORDS];
+  for (uint8_t i = 0; i < count; i++) batch[i] = &samples[i];
+  uint8_t payload[MQTT_MAX_PAYLOAD];
+  uint8_t n;
+  size_t len = telemetry.encodeBatch(payload, sizeof(payload), _encoding[PAYLOAD_TELEMETRY], batch, ts, count, n);
+  if (!n) { // Cannot happen with the current key set, but never wedge the journal
+    journal.commitRead(1);
+    return;
+  }
+
+  bool ok = _client->publish(TOPIC_PUB, payload, len, MQTT_TELEMETRY_QOS);
+  if (ok) journal.commitRead(n);
+  Serial.printf("[journal] Replay %s | %u records, %u bytes left\n", ok ? "OK" : "FAIL", n, (unsigned)journal.pendingBytes());
 }
 
+// Called from the motion task; the network task publishes every queued status in order
 void MqttManager::publishStatus(int status) {
-  statusaptl = status;
-  publishTelemetry();
+  if (xQueueSend(_statusQueue, &status, 0) != pdTRUE) {
+    _statusDropped++;
+    Serial.printf("[mqtt] Status %d not published: status queue full (%u dropped)\n", status, (unsigned)_statusDropped);
+  }
 }
 
 void MqttManager::printSubTick() {
-  Serial.printf("[sub] updated=%s | kodetoken=%s | home=%d | up=%d | down=%d | press1=%d | press2=%d | press3=%d | stop=%d | setmax=%d | row1=%d | row2=%d | row3=%d | row4=%d | newssid=%s | newpass=%s\n",
-                subUpdated ? "Yes" : "No", kodetoken.c_str(), home, up, down, press1, press2, press3, stop, setmax, row1, row2, row3, row4, newssid.c_str(), newpass.c_str());
-  subUpdated = false;
+  Serial.printf("[sub] rx=%u | queued=%u | kodetoken=%s | home=%d | up=%d | down=%d | press1=%d | press2=%d | press3=%d | stop=%d | setmax=%d | row1=%d | row2=%d | row3=%d | row4=%d | newssid=%s | newpass=%s\n",
+                (unsigned)_rxCount, (unsigned)commandQueue.depth(), kodetoken, home, up, down, press1, press2, press3, stop, setmax, row1, row2, row3, row4, newssid, newpass);
 }
 
-void MqttManager::_internalCallback(char* topic, byte* payload, unsigned int length) {
-    if (!_instance) return;
+//* MQTT INGRESS
+static const char TOPIC_RESP_PREFIX[] = "v1/devices/me/attributes/response/";
+static const char TOPIC_RPC_PREFIX[] = "v1/devices/me/rpc/request/";
+static const char TOPIC_RPC_RESPONSE[] = "v1/devices/me/rpc/response/";
+
+// Built once: every attribute key, at the top level and under "shared"
+void MqttManager::buildAttrFilter() {
+    _attrFilter.clear();
+    for (uint8_t i = 0; i < SHARED_ATTR_COUNT; i++) {
+        _attrFilter[SHARED_ATTRS[i].key] = true;
+        _attrFilter["shared"][SHARED_ATTRS[i].key] = true;
+    }
+    _rpcFilter.clear();
+    _rpcFilter["method"] = true;
+    _rpcFilter["params"] = true;
+}
 
-    static char payloadBuf[768];
-    unsigned int n = (length < sizeof(payloadBuf) - 1) ? length : sizeof(payloadBuf) - 1;
-    memcpy(payloadBuf, payload, n);
-    payloadBuf[n] = '\0';
+MqttManager::IngressRoute MqttManager::routeTopic(const char* topic) const {
+    if (!topic) return ROUTE_NONE;
+    if (strncmp(topic, TOPIC_RESP_PREFIX, sizeof(TOPIC_RESP_PREFIX) - 1) == 0) return ROUTE_ATTR_RESPONSE;
+    if (strcmp(topic, TOPIC_PUSH) == 0) return ROUTE_ATTR_PUSH;
+    if (strncmp(topic, TOPIC_RPC_PREFIX, sizeof(TOPIC_RPC_PREFIX) - 1) == 0) return ROUTE_RPC;
+    return ROUTE_NONE;
+}
 
+void MqttManager::handleMessage(const char* topic, const byte* payload, unsigned int length) {
+    IngressRoute route = routeTopic(topic);
+    if (route == ROUTE_NONE) return;
+    _rxCount++;
+
+    // Responses to anything but the outstanding request are not even parsed
+    if (route == ROUTE_ATTR_RESPONSE) {
+        uint32_t id = strtoul(topic + sizeof(TOPIC_RESP_PREFIX) - 1, nullptr, 10);
+        if (!_attrPendingMask || id != _attrRequestId) {
+            _attrStaleResponses++;
+            Serial.printf("[mqtt] Stale attribute response %u ignored (%u so far)\n", (unsigned)id, (unsigned)_attrStaleResponses);
+            return;
+        }
+    }
+
+    // Never parse a partial message: a cut-off kodetoken or keypad layout is worse than none
+    if (length > MQTT_MAX_PAYLOAD) {
+        _rxOversize++;
+        Serial.printf("[mqtt] %s: %u byte message over the %u byte limit, ignored (%u so far)\n",
+                      topic, length, (unsigned)MQTT_MAX_PAYLOAD, (unsigned)_rxOversize);
+        return;
+    }
+
+    unsigned long start = halMicros();
     JsonDocument doc;
-    DeserializationError err = deserializeJson(doc, payloadBuf);
+    DeserializationOption::Filter filter(route == ROUTE_RPC ? _rpcFilter : _attrFilter);
+    DeserializationError err = looksLikeJson(payload, length) ? deserializeJson(doc, payload, length, filter)
+                                                              : deserializeMsgPack(doc, payload, length, filter);
+    _rxParseUs = halMicros() - start;
+    if (_rxParseUs > _rxParseMaxUs) _rxParseMaxUs = _rxParseUs;
     if (err) {
-        Serial.printf("MQTT JSON parse error: %s\n", err.c_str());
+        _rxErrors++;
+        Serial.printf("[mqtt] %s: JSON parse error: %s\n", topic, err.c_str());
+        if (route == ROUTE_RPC) queueRpcResult({(uint32_t)strtoul(topic + sizeof(TOPIC_RPC_PREFIX) - 1, nullptr, 10), false, 0, "invalid JSON"});
         return;
     }
 
-    String t(topic ? topic : "");
-    if (t.startsWith("v1/devices/me/attributes/response/") || t == String(_instance->TOPIC_PUSH)) {
-        _instance->applyShared(doc.as<JsonVariant>());
+    if (route == ROUTE_RPC) {
+        handleRpc(strtoul(topic + sizeof(TOPIC_RPC_PREFIX) - 1, nullptr, 10), doc.as<JsonVariantConst>());
+        return;
     }
-}
 
-void MqttManager::processCommands() {
-    if (!subUpdated) return;
-
-    String tempKodeToken = kodetoken;
-    int tempHome = home;
-    int tempUp = up;
-    int tempDown = down;
-    int tempPress1 = press1;
-    int tempPress2 = press2;
-    int tempPress3 = press3;
-    int tempStop = stop;
-    int tempSetMax = setmax;
-    int tempRow1 = row1;
-    int tempRow2 = row2;
-    int tempRow3 = row3;
-    int tempRow4 = row4;
-    String tempNewSsid = newssid;
-    String tempNewPass = newpass;
-
-    subUpdated = false;
-    bool needSave = false;
+    applyShared(doc.as<JsonVariantConst>());
 
-    //* WiFi Settings
-    if (tempNewSsid.length() && tempNewSsid != prev_newssid && tempNewSsid != getWiFiSSID()) {
-        publishStatus(51); //* Setting WiFi SSID/Password
+    // Keys missing from the response are not set on the server: nothing more to learn
+    if (route == ROUTE_ATTR_RESPONSE) {
+        _uncertainAttrs &= ~_attrPendingMask;
+        _attrPendingMask = 0;
+    }
+}
 
-        Serial.printf("[mqtt] newssid received: %s\n", tempNewSsid.c_str());
-        setWiFiCredentials(tempNewSsid, tempNewPass);
-        fsManager.saveConfig();
-        wifiManager.init(getWiFiSSID(), getWiFiPassword());
-        wifiManager.connect();
+//* RPC
+const MqttManager::RpcMethod MqttManager::RPC_METHODS[] = {
+    {"moveTo",      CMD_MOVE_TO},       // params: mm, or {"mm": ..}
+    {"moveBy",      CMD_MOVE_BY},       // params: mm, or {"mm": ..}
+    {"press",       CMD_PRESS},         // params: servo 1-3, or {"servo": ..}
+    {"pressButton", CMD_PRESS_BUTTON},  // params: keypad button, or {"button": ..}
+    {"enterToken",  CMD_TOKEN},         // params: token, or {"token": ".."}
+    {"home",        CMD_HOME},
+    {"stop",        CMD_STOP},
+    {"resume",      CMD_RESUME},
+};
+
+// params may be the value itself or an object naming it
+static JsonVariantConst rpcParam(JsonVariantConst params, const char* name) {
+    return params.is<JsonObjectConst>() ? params[name] : params;
+}
 
-        publishStatus(0); //* Idle
+// Network task: validates the request and queues it; stop/resume are answered here
+void MqttManager::handleRpc(uint32_t id, JsonVariantConst request) {
+    const char* name = request["method"] | "";
+    JsonVariantConst params = request["params"];
+    RpcResult result = {id, false, 0, nullptr};
 
-        prev_newssid = tempNewSsid;
-        prev_newpass = tempNewPass;
+    const RpcMethod* method = nullptr;
+    for (const RpcMethod& m : RPC_METHODS) {
+        if (strcmp(m.name, name) == 0) {
+            method = &m;
+            break;
+        }
     }
-
-    //* Homing Motor
-    if (tempHome && prev_home == 0){
-        Serial.println("[mqtt] Command: HOME");
-        motorController.calibrate();
+    if (!method) {
+        result.error = "unknown method";
+        queueRpcResult(result);
+        return;
     }
-    prev_home = tempHome;
-
-    //* Motor Commands
-    if (tempUp && prev_up == 0) {
-        publishStatus(11); //* Moving Up
-
-        Serial.println("[mqtt] Command: UP");
-        motorController.moveBy(-10);
+    Serial.printf("[rpc] %u: %s\n", (unsigned)id, name);
+
+    uint8_t arg = 0;
+    int32_t value = 0;
+    const char* text = nullptr;
+    switch (method->command) {
+        case CMD_STOP:
+        case CMD_RESUME:
+            if (method->command == CMD_STOP) motorController.emergencyStop();
+            else motorController.clearEmergencyStop();
+            enqueue(method->command);
+            result.ok = true;
+            queueRpcResult(result);
+            return;
+
+        case CMD_MOVE_TO:
+        case CMD_MOVE_BY: {
+            JsonVariantConst mm = rpcParam(params, "mm");
+            if (!mm.is<float>() || !mmConvertible(mm.as<float>())) result.error = "invalid mm";
+            else value = mmToSteps(mm.as<float>());
+            break;
+        }
 
-        publishStatus(0); //* Idle
-    }
-    prev_up = tempUp;
+        case CMD_PRESS: {
+            int servo = rpcParam(params, "servo") | 0;
+            if (servo < 1 || servo > SERVO_COUNT) result.error = "invalid servo";
+            else arg = servo;
+            break;
+        }
 
-    if (tempDown && prev_down == 0) {
-        publishStatus(12); //* Moving Down
+        case CMD_PRESS_BUTTON: {
+            JsonVariantConst button = rpcParam(params, "button");
+            if (!button.is<int>() || button.as<int>() < 0 || button.as<int>() >= getKeypadLayout().buttonCount) result.error = "invalid button";
+            else arg = button.as<int>();
+            break;
+        }
 
-        Serial.println("[mqtt] Command: DOWN");
-        motorController.moveBy(10);
+        case CMD_TOKEN:
+            text = rpcParam(params, "token") | "";
+            if (!text[0] || strlen(text) >= COMMAND_TEXT_SIZE) result.error = "invalid token";
+            break;
 
-        publishStatus(0); //* Idle
+        default:
+            break;
     }
-    prev_down = tempDown;
 
-    //* Servo Commands
-    if (tempPress1 && prev_press1 == 0) {
-        publishStatus(21); //* Pressing Button 1
+    if (!result.error && !enqueue(method->command, arg, text, value, id)) result.error = "queue full";
+    if (result.error) queueRpcResult(result);
+}
 
-        Serial.println("[mqtt] Command: PRESS 1");
-        motorController.pressButton(1);
+// False when the transport did not take it (QoS 1 window full, link down)
+bool MqttManager::replyRpc(const RpcResult& result) {
+    char topic[48];
+    snprintf(topic, sizeof(topic), "%s%u", TOPIC_RPC_RESPONSE, (unsigned)result.id);
+    char payload[96];
+    size_t len;
+    if (_encoding[PAYLOAD_RPC_RESPONSE] == ENCODING_MSGPACK) {
+        MsgPackWriter writer((uint8_t*)payload, sizeof(payload));
+        writer.mapHeader(3);
+        writer.str("ok", 2);
+        writer.boolean(result.ok);
+        writer.str("ms", 2);
+        writer.integer(result.ms);
+        if (result.ok) {
+            writer.str("posisi", 6);
+            writer.number(motorController.getCurrentPosition());
+        } else {
+            writer.str("error", 5);
+            writer.str(result.error);
+        }
+        len = writer.length();
+    } else if (result.ok) {
+        len = snprintf(payload, sizeof(payload), "{\"ok\":true,\"ms\":%lu,\"posisi\":%.2f}", result.ms, motorController.getCurrentPosition());
+    } else {
+        len = snprintf(payload, sizeof(payload), "{\"ok\":false,\"error\":\"%s\",\"ms\":%lu}", result.error, result.ms);
+    }
+    if (!_client->publish(topic, (const uint8_t*)payload, len, MQTT_RPC_QOS)) return false;
+    Serial.printf("[rpc] %u OK | %s %s\n", (unsigned)result.id, result.ok ? "done" : "error:", result.ok ? "" : result.error);
+    return true;
+}
 
-        publishStatus(0); //* Idle
+// Replies go out in order. One the transport cannot take is held and retried on the
+// next loop() rather than lost, the rest wait behind it in _rpcQueue
+void MqttManager::publishRpcResults() {
+    if (!_client->connected()) return;
+    if (_rpcHeld && !replyRpc(_rpcHeldResult)) return;
+    _rpcHeld = false;
+
+    RpcResult result;
+    while (xQueueReceive(_rpcQueue, &result, 0) == pdTRUE) {
+        if (replyRpc(result)) continue;
+        Serial.printf("[rpc] %u reply held: transport busy\n", (unsigned)result.id);
+        _rpcHeldResult = result;
+        _rpcHeld = true;
+        return;
     }
-    prev_press1 = tempPress1;
-
-    if (tempPress2 && prev_press2 == 0) {
-        publishStatus(22); //* Pressing Button 2
-
-        Serial.println("[mqtt] Command: PRESS 2");
-        motorController.pressButton(2);
+}
 
-        publishStatus(0); //* Idle
+// Either task: replies are published from the network task by publishRpcResults()
+void MqttManager::queueRpcResult(const RpcResult& result) {
+    if (xQueueSend(_rpcQueue, &result, 0) != pdTRUE) {
+        Serial.printf("[rpc] Result for %u not published: queue full\n", (unsigned)result.id);
     }
-    prev_press2 = tempPress2;
+}
 
-    if (tempPress3 && prev_press3 == 0) {
-        publishStatus(23); //* Pressing Button 3
+// Motion task: only axis commands carry an RPC id, so at most one is running
+void MqttManager::beginRpc(const Command& cmd) {
+    _rpcActiveId = cmd.rpcId;
+    _rpcReceivedMs = cmd.receivedMs;
+}
 
-        Serial.println("[mqtt] Command: PRESS 3");
-        motorController.pressButton(3); 
+void MqttManager::finishRpc(bool ok, const char* error) {
+    if (!_rpcActiveId) return;
+    RpcResult result = {_rpcActiveId, ok, halMillis() - _rpcReceivedMs, ok ? nullptr : error};
+    _rpcActiveId = 0;
+    queueRpcResult(result);
+}
 
-        publishStatus(0); //* Idle
-    }
-    prev_press3 = tempPress3;
+void MqttManager::_internalCallback(char* topic, byte* payload, unsigned int length) {
+    if (!_instance) return;
+    _instance->handleMessage(topic, payload, length);
+}
 
-    //* Setting Max Position
-    if (tempSetMax && prev_setmax == 0) {
-        publishStatus(41); //* Setting Max Position
+// Async motor commands report Idle once the axis finishes
+void MqttManager::_onMotionFinished(MotionStatus status) {
+    if (!_instance) return;
+    if (status == MOTION_FAILED) Serial.println("[mqtt] Motor command failed.");
+    _instance->finishRpc(status == MOTION_DONE, motorController.isEmergencyStopped() ? "emergency stop" : "failed");
+    _instance->publishStatus(motorController.isEmergencyStopped() ? 91 : 0); //* Emergency Stop / Idle
+}
 
-        Serial.println("[mqtt] Command: SET MAX POSITION");
-        setMaxPosition(motorController.getCurrentPosition());
-        motorController.setMaximumPosition(motorController.getCurrentPosition());
+// Everything except stop/resume samples or moves the axis
+bool MqttManager::needsAxis(CommandType type) {
+    return type != CMD_STOP && type != CMD_RESUME;
+}
 
-        publishStatus(0); //* Idle
-    }
-    prev_setmax = tempSetMax;
+bool MqttManager::axisBusy() {
+    return motorController.isBusy() || tokenSequencer.isActive();
+}
 
-    //* Saving Line Coordinates
-    // set rows when changed (replace functionality)
-    if (tempRow1 != prev_row1) { 
-        publishStatus(31); //* Setting Row 1 Position
+bool MqttManager::isExecuting() {
+    return tokenSequencer.isActive() || commandQueue.depth() > 0;
+}
 
-        setLineCoordinate(1, motorController.getCurrentPosition()); 
-        needSave = true; 
+// Runs the compiled token timeline one action at a time
+void MqttManager::advanceToken() {
+    if (!tokenSequencer.isActive()) return;
+    if (motorController.isEmergencyStopped()) {
+        Serial.println("[mqtt] Token entry aborted by emergency stop.");
+        tokenSequencer.abort();
+        _tokensFailed++;
+        finishRpc(false, "emergency stop");
+        return;
     }
-    prev_row1 = tempRow1;
+    if (!tokenSequencer.update()) return;
 
-    if (tempRow2 != prev_row2) { 
-        publishStatus(32); //* Setting Row 2 Position
-
-        setLineCoordinate(2, motorController.getCurrentPosition()); 
-        needSave = true; 
+    if (tokenSequencer.succeeded()) _tokensDone++;
+    else {
+        _tokensFailed++;
+        Serial.println("[mqtt] Token entry failed.");
     }
-    prev_row2 = tempRow2;
-
-    if (tempRow3 != prev_row3) { 
-        publishStatus(33); //* Setting Row 3 Position
+    finishRpc(tokenSequencer.succeeded(), "failed");
+    publishStatus(0); //* Idle
+}
 
-        setLineCoordinate(3, motorController.getCurrentPosition()); 
-        needSave = true; 
-    }
-    prev_row3 = tempRow3;
-    
-    if (tempRow4 != prev_row4) { 
-        publishStatus(34); //* Setting Row 4 Position
+// Drains the command queue in arrival order. A command that needs the axis stays
+// at the head of the queue until the axis is free
+void MqttManager::processCommands() {
+    advanceToken();
 
-        setLineCoordinate(4, motorController.getCurrentPosition()); 
-        needSave = true; 
+    bool needSave = false;
+    const Command* cmd;
+    while ((cmd = commandQueue.peek()) != nullptr) {
+        if (needsAxis(cmd->type) && axisBusy()) break;
+        if (executeCommand(*cmd)) needSave = true;
+        commandQueue.pop();
     }
-    prev_row4 = tempRow4;
 
     if (needSave) {
         fsManager.saveConfig();
         Serial.println("[mqtt] Line coordinates updated and saved.");
         publishStatus(0); //* Idle
     }
+}
 
-    //* Token Input
-    if (tempKodeToken.length() && tempKodeToken != prev_kodetoken) {
-        publishStatus(1); //* Isi Token
+// Returns true when a line coordinate changed and the config needs saving
+bool MqttManager::executeCommand(const Command& cmd) {
+    if (cmd.rpcId) beginRpc(cmd);
+
+    switch (cmd.type) {
+        //* Emergency Stop (the latch itself is set/cleared in applyShared)
+        case CMD_STOP:
+        case CMD_RESUME:
+            Serial.printf("[mqtt] Command: %s\n", cmd.type == CMD_STOP ? "STOP" : "RESUME");
+            publishStatus(motorController.isEmergencyStopped() ? 91 : 0); //* Emergency Stop / Idle
+            return false;
+
+        //* Homing Motor
+        case CMD_HOME:
+            Serial.println("[mqtt] Command: HOME");
+            if (!motorController.calibrateAsync(_onMotionFinished)) finishRpc(false, "rejected");
+            return false;
+
+        //* Motor Commands
+        case CMD_UP:
+            publishStatus(11); //* Moving Up
+
+            Serial.println("[mqtt] Command: UP");
+            if (!motorController.moveByAsync(-10, _onMotionFinished)) publishStatus(0); //* Idle
+            return false;
+
+        case CMD_DOWN:
+            publishStatus(12); //* Moving Down
+
+            Serial.println("[mqtt] Command: DOWN");
+            if (!motorController.moveByAsync(10, _onMotionFinished)) publishStatus(0); //* Idle
+            return false;
+
+        //* Servo Commands
+        case CMD_PRESS:
+            publishStatus(20 + cmd.arg); //* Pressing Button 1-3
+
+            Serial.printf("[mqtt] Command: PRESS %u\n", cmd.arg);
+            if (!motorController.pressAsync(cmd.arg, _onMotionFinished)) {
+                publishStatus(0); //* Idle
+                finishRpc(false, "rejected");
+            }
+            return false;
 
-        Serial.printf("[mqtt] Kode Token received: %s\n", tempKodeToken.c_str());
+        case CMD_PRESS_BUTTON:
+            publishStatus(20 + getKeypadLayout().keys[cmd.arg].servo); //* Pressing Button 1-3
 
-        if(!motorController.getMotorStatus()){
-            motorController.calibrate();
+            Serial.printf("[mqtt] Command: PRESS BUTTON %u\n", cmd.arg);
+            if (!motorController.pressSpecificButtonAsync(cmd.arg, _onMotionFinished)) {
+                publishStatus(0); //* Idle
+                finishRpc(false, "rejected");
+            }
+            return false;
+
+        //* RPC Moves (UP / DOWN are relative moves too, by a fixed 10 mm)
+        case CMD_MOVE_TO:
+        case CMD_MOVE_BY: {
+            steps_t target = cmd.type == CMD_MOVE_TO ? cmd.value : motorController.getPositionSteps() + cmd.value;
+            publishStatus(target < motorController.getPositionSteps() ? 11 : 12); //* Moving Up / Moving Down
+
+            Serial.printf("[mqtt] Command: MOVE TO %.2f mm\n", stepsToMm(target));
+            if (!motorController.moveToStepsAsync(target, _onMotionFinished)) {
+                publishStatus(0); //* Idle
+                finishRpc(false, "rejected");
+            }
+            return false;
         }
 
-        for (size_t i = 0; i < tempKodeToken.length(); i++) {
-            char c = tempKodeToken[i];
-            if (isdigit(static_cast<unsigned char>(c))) {
-                int digit = c - '0';
-                if (digit >= 0 && digit <= 11){
-                    Serial.printf("[mqtt] Pressing button %d\n", digit);
-                    motorController.pressSpecificButton(digit);
-                    delay(250); // delay between button presses
-                } else {
-                    Serial.printf("[mqtt] Invalid button number: %d\n", digit);
-                }
+        //* Setting Max Position
+        case CMD_SET_MAX:
+            publishStatus(41); //* Setting Max Position
+
+            Serial.println("[mqtt] Command: SET MAX POSITION");
+            {
+                DeviceConfigLock lock;
+                setMaxPosition(motorController.getCurrentPosition());
+                motorController.setMaximumPosition(motorController.getCurrentPosition());
             }
+
+            publishStatus(0); //* Idle
+            return false;
+
+        //* Saving Line Coordinates
+        case CMD_SET_ROW:
+            publishStatus(30 + cmd.arg); //* Setting Row 1-4 Position
+            {
+                DeviceConfigLock lock;
+                setLineCoordinate(cmd.arg, motorController.getCurrentPosition());
+            }
+            return true;
+
+        //* Keypad Layout (queued, so it never changes under a running token)
+        case CMD_SET_LAYOUT: {
+            KeypadLayout layout;
+            {
+                DeviceConfigLock lock;
+                layout = _pendingLayout;
+            }
+            if (sameKeypadLayout(layout, getKeypadLayout())) return false;
+            {
+                DeviceConfigLock lock;
+                setKeypadLayout(layout);
+                fsManager.saveConfig();
+            }
+            Serial.printf("[mqtt] Keypad layout updated: %u buttons\n", layout.buttonCount);
+            return false;
         }
-        motorController.moveTo(0); // return to home after input
 
-        publishStatus(0); //* Idle
+        //* Token Input (compiled into a timeline, then run from advanceToken())
+        case CMD_TOKEN:
+            publishStatus(1); //* Isi Token
 
-        prev_kodetoken = tempKodeToken;
+            Serial.printf("[mqtt] Kode Token received: %s\n", cmd.text);
+
+            if (tokenSequencer.compile(cmd.text) && tokenSequencer.start()) {
+                Serial.printf("[mqtt] Token compiled: %u keys, %u actions, estimated %lu ms\n",
+                              tokenSequencer.getPressCount(), tokenSequencer.getActionCount(),
+                              tokenSequencer.getEstimatedMs());
+            } else {
+                Serial.println("[mqtt] Token could not be compiled.");
+                publishStatus(0); //* Idle
+                finishRpc(false, "invalid token");
+            }
+            return false;
     }
+    return false;
 }
 
 bool MqttManager::is_connected() {
-    return _client.connected();
+    return _client->connected();
 }
\ No newline at end of file
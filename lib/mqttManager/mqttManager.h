@@ -3,44 +3,116 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
-#include <WiFi.h>
-#include <PubSubClient.h>
+#include "hal.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "../motorController/motorController.h"
+#include "tokenSequencer.h"
+#include "commandQueue.h"
+#include "telemetryBuffer.h"
+#include "telemetryJournal.h"
+#include "payloadEncoding.h"
+#include "mqttTransport.h"
+#include "pubSubTransport.h"
+#include "qos1Transport.h"
+
+#define WIFI_SSID_SIZE 33
+#define WIFI_PASS_SIZE 65
+#define STATUS_QUEUE_SIZE 16
+#define MQTT_MAX_PAYLOAD 768                   // Larger messages are reported and ignored
+#define MQTT_BUFFER_SIZE (MQTT_MAX_PAYLOAD + 128) // Transport packet buffer: payload + topic + header
+#define MQTT_KEEPALIVE_S 60
+#define MQTT_SOCKET_TIMEOUT_S 2                 // Bounds a single connect attempt (CONNACK wait)
+#define MQTT_BACKOFF_MIN_MS 1000                // Reconnect delay after the first failure, doubled per failure
+#define MQTT_BACKOFF_MAX_MS 60000
+#define TELEMETRY_NTP_SERVER "pool.ntp.org"
+#define RPC_QUEUE_SIZE 8
+#define ATTR_REQUEST_TIMEOUT_MS 10000          // Unanswered attribute request is sent again
+#ifndef MQTT_TELEMETRY_ENCODING
+#define MQTT_TELEMETRY_ENCODING ENCODING_JSON    // ENCODING_MSGPACK needs a backend that decodes it, see payloadEncoding.h
+#endif
+#ifndef MQTT_RPC_ENCODING
+#define MQTT_RPC_ENCODING ENCODING_JSON
+#endif
+#define MQTT_TELEMETRY_QOS 1 // Sent as QoS 0 by a transport without QoS 1 (PubSubClient)
+#define MQTT_RPC_QOS 1
 
 class WifiManager;
 class FSManager;
-class MotorController;
+
+// Runs on two tasks: the network task owns the MQTT transport (poll, connect, publish,
+// attribute callbacks), the motion task executes queued commands. Commands travel
+// network -> motion through CommandQueue plus a task notification, status updates
+// travel motion -> network through a FreeRTOS queue, since the transports are not thread-safe.
+//
+// Transport: PubSubClient (QoS 0), or Qos1Transport when built with -D APTL_MQTT_QOS1,
+// or any MqttTransport handed to setTransport() before init().
+
+// Outgoing payloads with a selectable encoding; incoming ones are detected per message
+enum MqttPayloadTopic : uint8_t {
+    PAYLOAD_TELEMETRY,
+    PAYLOAD_RPC_RESPONSE,
+    PAYLOAD_TOPIC_COUNT,
+};
 
 class MqttManager {
 public:
     MqttManager();
     void init(const IPAddress& broker, uint16_t port = 1883,
               const String& clientId = "aptl-client", const char* user = "", const char* pass = nullptr);
-    void connect();
-    void loop();
-    void processCommands();
+    void connect();       // Attempt on the next loop() instead of waiting out the backoff
+    void loop();          // Network task: connection, transport poll, queued status and WiFi changes
+    void setTransport(MqttTransport* transport) { _client = transport; } // Before init()
+
+    void setExecutorTask(TaskHandle_t task) { _executorTask = task; }
+    void processCommands(); // Motion task: runs queued commands and token entry
+    bool isExecuting();     // Commands waiting or a token running
 
-    void requestShared();
-    void applyShared(JsonVariant root);
+    void requestShared();   // Requests the attributes not confirmed since the last (re)connect
+    void applyShared(JsonVariantConst root);
 
-    void publishTelemetry();
+    void publishTelemetry(); // Samples now, published in batches (status changes right away)
+    void setEncoding(MqttPayloadTopic topic, PayloadEncoding encoding) { _encoding[topic] = encoding; }
     void printSubTick();
 
     bool is_connected();
 
 private:
-    WiFiClient      _wifiClient;
-    PubSubClient    _client{_wifiClient};
+    HalNetClient    _wifiClient;
+#ifdef APTL_MQTT_QOS1
+    Qos1Transport   _defaultTransport{_wifiClient};
+#else
+    PubSubTransport _defaultTransport{_wifiClient};
+#endif
+    MqttTransport*  _client = &_defaultTransport;
     IPAddress       _broker;
     uint16_t        _port{1883};
     String          _clientId;
     const char*     _user;
     const char*     _pass;
+    bool            _initialised = false;
+    PayloadEncoding _encoding[PAYLOAD_TOPIC_COUNT] = {MQTT_TELEMETRY_ENCODING, MQTT_RPC_ENCODING};
+
+    // Connection state machine, advanced from loop(); at most one connect attempt per call
+    enum ConnState : uint8_t {
+        CONN_WAITING,   // Backoff running, or no WiFi
+        CONN_CONNECTED,
+    };
+    ConnState     _connState = CONN_WAITING;
+    unsigned long _nextAttemptMs = 0;
+    unsigned long _backoffMs = 0;       // 0 until the first failure
+    uint32_t      _connectAttempts = 0;
+    uint32_t      _connectFailures = 0;
+    uint32_t      _disconnects = 0;
+    unsigned long _connectLatencyMs = 0; // Last successful attempt
 
     // Topic standar ThingsBoard
     const char* TOPIC_PUB  = "v1/devices/me/telemetry";             // publish telemetry
-    const char* TOPIC_REQ  = "v1/devices/me/attributes/request/1";  // request shared attrs
+    const char* TOPIC_REQ  = "v1/devices/me/attributes/request/";   // request shared attrs, + request id
     const char* TOPIC_RESP = "v1/devices/me/attributes/response/+"; // response attrs
     const char* TOPIC_PUSH = "v1/devices/me/attributes";            // push realtime
+    const char* TOPIC_RPC  = "v1/devices/me/rpc/request/+";         // server-side RPC
 
     // Telemetry yang akan dikirim (random)
     float posisi = 0.0f;
@@ -65,30 +137,168 @@ private:
 
     //* 51 = Setting WiFi SSID/Password
 
+    //* 91 = Emergency Stop
+
 
-    // Cache shared attributes yang diterima
-    String kodetoken = "";
+    // Last value of each shared attribute, edges are queued as commands
+    char  kodetoken[COMMAND_TEXT_SIZE] = "";
     int   home = 0;
     int   up = 0, down = 0;
     int   press1 = 0, press2 = 0, press3 = 0;
     int   stop = 0;
     int   setmax = 0;
     int   row1 = 0, row2 = 0, row3 = 0, row4 = 0;
-    String newssid = "", newpass = "";
+    char  newssid[WIFI_SSID_SIZE] = "", newpass[WIFI_PASS_SIZE] = "";
+    bool  wifiChangePending = false; // Network task only
+    KeypadLayout _pendingLayout;     // CMD_SET_LAYOUT, under DeviceConfigLock
+
+    // Filled by the MQTT callback, drained by processCommands()
+    CommandQueue commandQueue;
+    TaskHandle_t _executorTask = nullptr;
+
+    // Status codes for telemetry, filled by the motion task and published by the network task
+    QueueHandle_t _statusQueue;
+    uint32_t _statusDropped = 0;
+
+    // Token entry in progress, advanced from processCommands()
+    TokenSequencer tokenSequencer;
+
+    // Outgoing telemetry, one entry per key in TELEMETRY_KEYS order
+    enum TelemetryField : uint8_t {
+        TLM_POSISI,
+        TLM_STATUS,
+        TLM_ESTOP,
+        TLM_STOP_LATENCY,
+        TLM_HOMING_MS,
+        TLM_HOMING_REP,
+        TLM_CMDQ,
+        TLM_CMDQ_MAX,
+        TLM_CMDQ_DROP,
+        TLM_RX_PARSE_US,
+        TLM_RX_PARSE_MAX,
+        TLM_RX_DROP,
+        TLM_MQTT_CONN,
+        TLM_MQTT_CONN_MS,
+        TLM_MQTT_DISC,
+        TLM_TELEMETRY_DROP,
+        TLM_JOURNAL_BYTES,
+        TLM_TOKENS,
+        TLM_TOKEN_FAILS,
+        TLM_MQTT_INFLIGHT,
+        TLM_MQTT_RETX,
+#if APTL_MOTION_STATS
+        TLM_JITTER_P99,
+        TLM_JITTER_MAX,
+        TLM_MOVE_SPS,
+#endif
+        TLM_COUNT,
+    };
+    static const TelemetryKey TELEMETRY_KEYS[];
+    TelemetryBuffer telemetry{TELEMETRY_KEYS, TLM_COUNT};
+    TelemetryJournal journal;          // Samples that could not be published, replayed after reconnect
+    unsigned long _lastReplayMs = 0;
+    uint32_t _tokensDone = 0;          // Token entries finished / failed, written by the motion task
+    uint32_t _tokensFailed = 0;
+
+    // Incoming messages: routed by topic prefix, parsed straight from the transport
+    // buffer through a filter that keeps only the attribute keys in SHARED_ATTRS
+    enum IngressRoute : uint8_t {
+        ROUTE_NONE,
+        ROUTE_ATTR_PUSH,
+        ROUTE_ATTR_RESPONSE,
+        ROUTE_RPC,
+    };
+    JsonDocument _attrFilter;
+    JsonDocument _rpcFilter;
+    uint32_t _rxCount = 0;
+    uint32_t _rxOversize = 0;
+    uint32_t _rxErrors = 0;
+    unsigned long _rxParseUs = 0;    // Last message
+    unsigned long _rxParseMaxUs = 0;
+
+    // Shared attribute descriptor table, see SHARED_ATTRS in mqttManager.cpp
+    enum SharedAttrKind : uint8_t {
+        ATTR_RISING,  // int, queues `command` when it goes from 0 to non-zero
+        ATTR_CHANGE,  // int, queues `command` on any change
+        ATTR_HANDLER, // passed to `handler`
+    };
+    struct SharedAttr {
+        const char* key;
+        uint8_t keyLength;
+        SharedAttrKind kind;
+        bool requested;                                 // included in requestShared()
+        int MqttManager::* slot;                        // last value, edge kinds
+        CommandType command;
+        uint8_t arg;
+        void (MqttManager::* handler)(JsonVariantConst value);
+    };
+    static const SharedAttr SHARED_ATTRS[];
+    static const uint8_t SHARED_ATTR_COUNT;
+
+    // Push first: attributes arrive on TOPIC_PUSH, a request only names the keys (bit i =
+    // SHARED_ATTRS[i]) not seen since the last (re)connect, and its response is matched by id
+    uint32_t _uncertainAttrs = 0;
+    uint32_t _attrRequestId = 0;      // Last request sent
+    uint32_t _attrPendingMask = 0;    // Keys named in it, 0 = nothing outstanding
+    unsigned long _attrRequestMs = 0;
+    uint32_t _attrStaleResponses = 0;
+
+    void onStop(JsonVariantConst value);
+    void onKodetoken(JsonVariantConst value);
+    void onNewSsid(JsonVariantConst value);
+    void onNewPass(JsonVariantConst value);
+    void onKeypad(JsonVariantConst value);
+
+    void serviceAttributes();
+    void serviceConnection();
+    void attemptConnect(unsigned long now);
+    void onConnected();
+
+    // Server-side RPC: requests become commands carrying the RPC id, the motion task
+    // reports the outcome through _rpcQueue and the network task answers. Replies made
+    // by the network task itself take the same queue, so they all go out in order
+    struct RpcMethod {
+        const char* name;
+        CommandType command;
+    };
+    static const RpcMethod RPC_METHODS[];
+    struct RpcResult {
+        uint32_t id;
+        bool ok;
+        unsigned long ms;   // Since the request arrived
+        const char* error;  // String literal, nullptr when ok
+    };
+    QueueHandle_t _rpcQueue;
+    uint32_t _rpcActiveId = 0;         // Motion task: command waiting for completion
+    unsigned long _rpcReceivedMs = 0;
+    RpcResult _rpcHeldResult;          // Network task: reply the transport could not take yet
+    bool _rpcHeld = false;
+
+    void handleRpc(uint32_t id, JsonVariantConst request);
+    bool replyRpc(const RpcResult& result);
+    void publishRpcResults();
+    void queueRpcResult(const RpcResult& result);
+    void beginRpc(const Command& cmd);
+    void finishRpc(bool ok, const char* error = nullptr);
 
-    // Previous state to detect changes
-    String prev_kodetoken = "default";
-    int prev_home = 0;
-    int prev_up = 0, prev_down = 0;
-    int prev_press1 = 0, prev_press2 = 0, prev_press3 = 0;
-    int prev_stop = 0;
-    int prev_setmax = 0;
-    int prev_row1 = 0, prev_row2 = 0, prev_row3 = 0, prev_row4 = 0;
-    String prev_newssid = "default", prev_newpass = "default";
+    void buildAttrFilter();
+    IngressRoute routeTopic(const char* topic) const;
+    void handleMessage(const char* topic, const byte* payload, unsigned int length);
 
-    volatile bool subUpdated = false;
+    void sampleTelemetry();
+    void flushTelemetry();
+    void spillTelemetry();
+    void replayJournal();
 
     void publishStatus(int status);
+    bool enqueue(CommandType type, uint8_t arg = 0, const char* text = nullptr, int32_t value = 0, uint32_t rpcId = 0);
+    void publishQueuedStatus();
+    void applyWifiChange();
+    bool executeCommand(const Command& cmd);
+    static bool needsAxis(CommandType type);
+    bool axisBusy();
+    void advanceToken();
+    static void _onMotionFinished(MotionStatus status);
 
     static MqttManager* _instance;
     static void _internalCallback(char* topic, byte* payload, unsigned int length);
@@ -0,0 +1,46 @@
+#ifndef MQTT_TRANSPORT_H
+#define MQTT_TRANSPORT_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <IPAddress.h>
+
+// MQTT client as MqttManager sees it. Used from the network task only; the message
+// callback runs inside poll().
+//
+// state(): 0 connected, negative = connection problem, positive = CONNACK return code
+// (the PubSubClient MQTT_* codes, so logs read the same with either implementation).
+enum MqttTransportState {
+    MQTT_STATE_CONNECTION_TIMEOUT = -4, // No CONNACK or PINGRESP in time
+    MQTT_STATE_CONNECTION_LOST = -3,
+    MQTT_STATE_CONNECT_FAILED = -2,     // TCP connect failed
+    MQTT_STATE_DISCONNECTED = -1,
+    MQTT_STATE_CONNECTED = 0,
+};
+
+class MqttTransport {
+public:
+    typedef void (*MessageCallback)(char* topic, uint8_t* payload, unsigned int length);
+
+    virtual ~MqttTransport() {}
+
+    // Sets up buffers of `bufferSize` bytes (whole packet: header, topic and payload);
+    // false if they could not be allocated
+    virtual bool begin(const IPAddress& broker, uint16_t port, uint16_t bufferSize, uint16_t keepAliveS,
+                       uint16_t socketTimeoutS, MessageCallback callback) = 0;
+    // Blocks for at most the TCP connect plus socketTimeoutS waiting for the CONNACK
+    virtual bool connect(const char* clientId, const char* user, const char* pass) = 0;
+    virtual bool connected() = 0;
+    virtual int state() = 0;
+    virtual void poll() = 0; // Reads incoming packets, keepalive, retransmits
+
+    virtual bool subscribe(const char* topic) = 0;
+    // true once the transport has taken the message: written (QoS 0) or held until
+    // acknowledged (QoS 1). A transport without QoS 1 sends it as QoS 0.
+    virtual bool publish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos = 0) = 0;
+
+    virtual uint8_t inFlight() const { return 0; }         // QoS 1 publishes waiting for PUBACK
+    virtual uint32_t getRetransmits() const { return 0; }
+};
+
+#endif // MQTT_TRANSPORT_H
@@ -0,0 +1,138 @@
+#ifndef PAYLOAD_ENCODING_H
+#define PAYLOAD_ENCODING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Wire encoding of an MQTT payload, chosen per topic (see MqttManager::setEncoding).
+//
+// Backend contract: a MessagePack payload carries exactly the document the JSON one
+// would, so a consumer decodes it with any MessagePack library and hands the result to
+// the same code that handles JSON:
+//   telemetry      [{"ts": uint, "values": {key: number, ..}}, ..], each entry just the
+//                  values map while the device clock is not set
+//   rpc/response   {"ok": bool, "ms": uint, "posisi": float} or {"ok": false, "error": str, "ms": uint}
+// Numbers that are whole are sent as the smallest MessagePack int, the rest as float32.
+// Incoming attributes and RPC requests may use either encoding: a payload whose first
+// byte is '{', '[' or whitespace is JSON, anything else is MessagePack.
+enum PayloadEncoding : uint8_t {
+    ENCODING_JSON,
+    ENCODING_MSGPACK,
+};
+
+inline bool looksLikeJson(const uint8_t* payload, size_t length) {
+    if (!length) return false;
+    uint8_t c = payload[0];
+    return c == '{' || c == '[' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Minimal MessagePack writer into a caller-provided buffer: the subset telemetry and RPC
+// responses need, no allocation. Running out of room sets overflowed() and stops writing.
+class MsgPackWriter {
+public:
+    MsgPackWriter(uint8_t* out, size_t size) : out(out), size(size), len(0), overflow(false) {}
+
+    void mapHeader(uint32_t n) {
+        if (n < 16) put(0x80 | n);
+        else header(0xde, 0xdf, n);
+    }
+    void arrayHeader(uint32_t n) {
+        if (n < 16) put(0x90 | n);
+        else header(0xdc, 0xdd, n);
+    }
+    // Array whose length is only known at the end: array32 header, patched by endArray()
+    size_t beginArray() {
+        size_t at = len;
+        put(0xdd);
+        be(0, 4);
+        return at;
+    }
+    void endArray(size_t at, uint32_t n) {
+        if (overflow) return;
+        for (uint8_t i = 0; i < 4; i++) out[at + 1 + i] = n >> (24 - 8 * i);
+    }
+
+    void str(const char* s) { str(s, strlen(s)); }
+    void str(const char* s, size_t n) {
+        if (n < 32) put(0xa0 | n);
+        else if (n < 256) {
+            put(0xd9);
+            put(n);
+        } else {
+            put(0xda);
+            be(n, 2);
+        }
+        bytes(s, n);
+    }
+    void boolean(bool b) { put(b ? 0xc3 : 0xc2); }
+    void integer(int64_t v) {
+        if (v >= 0) {
+            if (v < 128) put(v);
+            else if (v < 256) { put(0xcc); put(v); }
+            else if (v < 65536) { put(0xcd); be(v, 2); }
+            else if (v < 4294967296LL) { put(0xce); be(v, 4); }
+            else { put(0xcf); be(v, 8); }
+        } else {
+            if (v >= -32) put((uint8_t)(int8_t)v);
+            else if (v >= -128) { put(0xd0); put((uint8_t)(int8_t)v); }
+            else if (v >= -32768) { put(0xd1); be((uint16_t)(int16_t)v, 2); }
+            else if (v >= -2147483648LL) { put(0xd2); be((uint32_t)(int32_t)v, 4); }
+            else { put(0xd3); be((uint64_t)v, 8); }
+        }
+    }
+    // Whole numbers in int32 range go out as ints, like "%.7g" does for JSON
+    void number(float v) {
+        if (v > -2147483648.0f && v < 2147483648.0f && v == (float)(int32_t)v) {
+            integer((int32_t)v);
+            return;
+        }
+        uint32_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        put(0xca);
+        be(bits, 4);
+    }
+
+    size_t length() const { return len; }
+    bool overflowed() const { return overflow; }
+    void rewind(size_t to) { // Drops everything after `to`, e.g. a sample that did not fit
+        len = to;
+        overflow = false;
+    }
+
+private:
+    uint8_t* out;
+    size_t size;
+    size_t len;
+    bool overflow;
+
+    void put(uint8_t b) {
+        if (len >= size) {
+            overflow = true;
+            return;
+        }
+        out[len++] = b;
+    }
+    void be(uint64_t v, uint8_t n) {
+        for (uint8_t i = n; i > 0; i--) put(v >> (8 * (i - 1)));
+    }
+    void bytes(const char* s, size_t n) {
+        if (len + n > size) {
+            overflow = true;
+            return;
+        }
+        memcpy(out + len, s, n);
+        len += n;
+    }
+    void header(uint8_t small, uint8_t large, uint32_t n) {
+        if (n < 65536) {
+            put(small);
+            be(n, 2);
+        } else {
+            put(large);
+            be(n, 4);
+        }
+    }
+};
+
+#endif // PAYLOAD_ENCODING_H
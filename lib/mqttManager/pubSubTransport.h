@@ -0,0 +1,39 @@
+#ifndef PUB_SUB_TRANSPORT_H
+#define PUB_SUB_TRANSPORT_H
+
+#include <PubSubClient.h>
+#include "mqttTransport.h"
+
+// PubSubClient behind MqttTransport: QoS 0 publishes only, incoming packets are read
+// whole inside poll()
+class PubSubTransport : public MqttTransport {
+public:
+    explicit PubSubTransport(Client& net) : client(net) {}
+
+    bool begin(const IPAddress& broker, uint16_t port, uint16_t bufferSize, uint16_t keepAliveS,
+               uint16_t socketTimeoutS, MessageCallback callback) override {
+        client.setServer(broker, port);
+        client.setCallback(callback);
+        client.setSocketTimeout(socketTimeoutS);
+        client.setKeepAlive(keepAliveS);
+        return client.setBufferSize(bufferSize);
+    }
+    bool connect(const char* clientId, const char* user, const char* pass) override {
+        if (user && strlen(user)) return client.connect(clientId, user, pass);
+        return client.connect(clientId);
+    }
+    bool connected() override { return client.connected(); }
+    int state() override { return client.state(); }
+    void poll() override { client.loop(); }
+
+    bool subscribe(const char* topic) override { return client.subscribe(topic); }
+    bool publish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos) override {
+        (void)qos;
+        return client.publish(topic, payload, length);
+    }
+
+private:
+    PubSubClient client;
+};
+
+#endif // PUB_SUB_TRANSPORT_H
@@ -0,0 +1,338 @@
+#include "qos1Transport.h"
+#include "hal.h"
+
+// MQTT 3.1.1 control packet types (upper nibble of the fixed header)
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_SUBSCRIBE 0x82 // Flags 0010 are mandatory
+#define MQTT_SUBACK 0x90
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_PUBLISH_QOS1 0x02
+#define MQTT_PUBLISH_DUP 0x08
+
+static size_t lengthBytes(size_t length) {
+    return length < 128 ? 1 : length < 16384 ? 2 : length < 2097152 ? 3 : 4;
+}
+
+static uint8_t* putLength(uint8_t* p, size_t length) {
+    do {
+        uint8_t b = length % 128;
+        length /= 128;
+        *p++ = length ? b | 0x80 : b;
+    } while (length);
+    return p;
+}
+
+static uint8_t* putU16(uint8_t* p, uint16_t v) {
+    *p++ = v >> 8;
+    *p++ = v & 0xFF;
+    return p;
+}
+
+static uint8_t* putString(uint8_t* p, const char* s, size_t n) {
+    p = putU16(p, n);
+    memcpy(p, s, n);
+    return p + n;
+}
+
+Qos1Transport::Qos1Transport(Client& net)
+    : net(net), port(1883), bufferSize(0), keepAliveS(60), socketTimeoutS(2), callback(nullptr),
+      st(MQTT_STATE_DISCONNECTED), memory(nullptr), rx(nullptr), tx(nullptr), lastId(0), retransmits(0),
+      rxSkipped(0), lastOutMs(0), lastInMs(0), pingOutstanding(false), rxState(RX_HEADER), rxHeader(0),
+      rxLength(0), rxPos(0), rxShift(0) {
+    for (uint8_t i = 0; i < MQTT_QOS1_WINDOW; i++) window[i] = {0, 0, 0, nullptr};
+}
+
+Qos1Transport::~Qos1Transport() {
+    free(memory);
+}
+
+bool Qos1Transport::begin(const IPAddress& broker, uint16_t port, uint16_t bufferSize, uint16_t keepAliveS,
+                          uint16_t socketTimeoutS, MessageCallback callback) {
+    this->broker = broker;
+    this->port = port;
+    this->keepAliveS = keepAliveS;
+    this->socketTimeoutS = socketTimeoutS;
+    this->callback = callback;
+    if (memory && bufferSize == this->bufferSize) return true;
+
+    // Anything in flight was framed for the old buffer: start over
+    free(memory);
+    memory = (uint8_t*)malloc((size_t)bufferSize * (2 + MQTT_QOS1_WINDOW));
+    this->bufferSize = memory ? bufferSize : 0;
+    rx = memory;
+    tx = memory ? memory + bufferSize : nullptr;
+    for (uint8_t i = 0; i < MQTT_QOS1_WINDOW; i++) {
+        window[i] = {0, 0, 0, memory ? memory + (size_t)bufferSize * (2 + i) : nullptr};
+    }
+    return memory != nullptr;
+}
+
+bool Qos1Transport::connect(const char* clientId, const char* user, const char* pass) {
+    if (!memory) {
+        st = MQTT_STATE_CONNECT_FAILED;
+        return false;
+    }
+    if (net.connected()) net.stop();
+    if (!net.connect(broker, port)) {
+        st = MQTT_STATE_CONNECT_FAILED;
+        return false;
+    }
+
+    bool withUser = user && strlen(user);
+    bool withPass = withUser && pass;
+    size_t idLength = strlen(clientId);
+    size_t body = 10 + 2 + idLength + (withUser ? 2 + strlen(user) : 0) + (withPass ? 2 + strlen(pass) : 0);
+    if (1 + lengthBytes(body) + body > bufferSize) {
+        drop(MQTT_STATE_CONNECT_FAILED);
+        return false;
+    }
+    uint8_t* p = tx;
+    *p++ = MQTT_CONNECT;
+    p = putLength(p, body);
+    p = putString(p, "MQTT", 4);
+    *p++ = 4;                                                   // Protocol level 3.1.1
+    *p++ = 0x02 | (withUser ? 0x80 : 0) | (withPass ? 0x40 : 0); // Clean session
+    p = putU16(p, keepAliveS);
+    p = putString(p, clientId, idLength);
+    if (withUser) p = putString(p, user, strlen(user));
+    if (withPass) p = putString(p, pass, strlen(pass));
+
+    rxState = RX_HEADER;
+    pingOutstanding = false;
+    if (!write(tx, p - tx)) {
+        drop(MQTT_STATE_CONNECTION_LOST);
+        return false;
+    }
+
+    // The only wait in this class, bounded like PubSubClient's
+    unsigned long start = halMillis();
+    while (halMillis() - start < socketTimeoutS * 1000UL) {
+        if (readPacket()) {
+            if ((rxHeader & 0xF0) != MQTT_CONNACK || rxLength != 2) break;
+            if (rx[1] != 0) {
+                drop(rx[1]); // Refused: bad credentials, unknown client, ..
+                return false;
+            }
+            st = MQTT_STATE_CONNECTED;
+            lastInMs = lastOutMs = halMillis();
+            for (uint8_t i = 0; i < MQTT_QOS1_WINDOW; i++) {
+                if (window[i].id) resend(window[i]);
+            }
+            return true;
+        }
+        if (!net.connected()) break;
+        halDelay(1);
+    }
+    drop(MQTT_STATE_CONNECTION_TIMEOUT);
+    return false;
+}
+
+bool Qos1Transport::connected() {
+    if (st != MQTT_STATE_CONNECTED) return false;
+    if (net.connected()) return true;
+    drop(MQTT_STATE_CONNECTION_LOST);
+    return false;
+}
+
+void Qos1Transport::drop(int reason) {
+    net.stop();
+    st = reason;
+    rxState = RX_HEADER;
+    pingOutstanding = false;
+}
+
+void Qos1Transport::poll() {
+    if (!connected()) return;
+    while (readPacket()) handlePacket();
+    if (st != MQTT_STATE_CONNECTED) return;
+
+    unsigned long now = halMillis();
+    unsigned long keepAliveMs = keepAliveS * 1000UL;
+    if (keepAliveMs && (now - lastInMs > keepAliveMs || now - lastOutMs > keepAliveMs)) {
+        if (pingOutstanding) {
+            drop(MQTT_STATE_CONNECTION_TIMEOUT);
+            return;
+        }
+        const uint8_t ping[2] = {MQTT_PINGREQ, 0};
+        write(ping, sizeof(ping));
+        lastInMs = now;
+        pingOutstanding = true;
+    }
+
+    for (uint8_t i = 0; i < MQTT_QOS1_WINDOW; i++) {
+        if (window[i].id && now - window[i].sentMs >= MQTT_QOS1_RETRY_MS) resend(window[i]);
+    }
+}
+
+// Feeds the bytes that have arrived to the parser; true as soon as one whole packet is
+// in rx (type in rxHeader, rxLength body bytes), the rest stays in the socket
+bool Qos1Transport::readPacket() {
+    while (net.available() > 0) {
+        lastInMs = halMillis();
+        if (rxState == RX_BODY) {
+            int n = net.read(rx + rxPos, rxLength - rxPos);
+            if (n <= 0) return false;
+            rxPos += n;
+            if (rxPos < rxLength) continue;
+            rxState = RX_HEADER;
+            return true;
+        }
+
+        int c = net.read();
+        if (c < 0) return false;
+        switch (rxState) {
+            case RX_HEADER:
+                rxHeader = c;
+                rxLength = 0;
+                rxShift = 0;
+                rxState = RX_LENGTH;
+                break;
+            case RX_LENGTH:
+                rxLength |= (uint32_t)(c & 0x7F) << rxShift;
+                rxShift += 7;
+                if (c & 0x80) {
+                    if (rxShift >= 28) { // Malformed, more than 4 length bytes
+                        drop(MQTT_STATE_CONNECTION_LOST);
+                        return false;
+                    }
+                    break;
+                }
+                rxPos = 0;
+                if (!rxLength) {
+                    rxState = RX_HEADER;
+                    return true;
+                }
+                if (rxLength > bufferSize) {
+                    rxSkipped++;
+                    rxState = RX_SKIP;
+                } else {
+                    rxState = RX_BODY;
+                }
+                break;
+            case RX_SKIP:
+                if (++rxPos == rxLength) rxState = RX_HEADER;
+                break;
+            case RX_BODY:
+                break;
+        }
+    }
+    return false;
+}
+
+void Qos1Transport::handlePacket() {
+    switch (rxHeader & 0xF0) {
+        case MQTT_PUBLISH: {
+            if (rxLength < 2) return;
+            uint16_t topicLength = (rx[0] << 8) | rx[1];
+            uint8_t qos = (rxHeader >> 1) & 0x03;
+            size_t payloadAt = 2 + topicLength + (qos ? 2 : 0);
+            if (payloadAt > rxLength) return;
+            if (qos == 1) {
+                uint8_t ack[4] = {MQTT_PUBACK, 2, rx[2 + topicLength], rx[3 + topicLength]};
+                write(ack, sizeof(ack));
+            }
+            // Topic moved down over its length prefix to make room for the terminator
+            memmove(rx, rx + 2, topicLength);
+            rx[topicLength] = '\0';
+            if (callback) callback((char*)rx, rx + payloadAt, rxLength - payloadAt);
+            return;
+        }
+        case MQTT_PUBACK: {
+            if (rxLength < 2) return;
+            uint16_t id = (rx[0] << 8) | rx[1];
+            for (uint8_t i = 0; i < MQTT_QOS1_WINDOW; i++) {
+                if (window[i].id == id) window[i].id = 0;
+            }
+            return;
+        }
+        case MQTT_PINGRESP:
+            pingOutstanding = false;
+            return;
+        default: // SUBACK, and nothing else is expected
+            return;
+    }
+}
+
+bool Qos1Transport::write(const uint8_t* packet, size_t length) {
+    size_t n = net.write(packet, length);
+    lastOutMs = halMillis();
+    return n == length;
+}
+
+void Qos1Transport::resend(Slot& slot) {
+    slot.packet[0] |= MQTT_PUBLISH_DUP;
+    slot.sentMs = halMillis();
+    retransmits++;
+    write(slot.packet, slot.length); // Failing here is caught by connected()
+}
+
+uint16_t Qos1Transport::nextId() {
+    for (;;) {
+        if (++lastId == 0) lastId = 1;
+        bool used = false;
+        for (uint8_t i = 0; i < MQTT_QOS1_WINDOW; i++) used |= window[i].id == lastId;
+        if (!used) return lastId;
+    }
+}
+
+// PUBLISH packet into `out`, 0 if it does not fit the buffer; id only for QoS 1
+size_t Qos1Transport::frame(uint8_t* out, uint8_t header, const char* topic, uint16_t id, const uint8_t* payload,
+                            size_t length) const {
+    size_t topicLength = strlen(topic);
+    size_t body = 2 + topicLength + (header & MQTT_PUBLISH_QOS1 ? 2 : 0) + length;
+    if (1 + lengthBytes(body) + body > bufferSize) return 0;
+    uint8_t* p = out;
+    *p++ = header;
+    p = putLength(p, body);
+    p = putString(p, topic, topicLength);
+    if (header & MQTT_PUBLISH_QOS1) p = putU16(p, id);
+    memcpy(p, payload, length);
+    return p + length - out;
+}
+
+bool Qos1Transport::publish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos) {
+    if (!connected()) return false;
+    if (!qos) {
+        size_t n = frame(tx, MQTT_PUBLISH, topic, 0, payload, length);
+        return n && write(tx, n);
+    }
+
+    Slot* slot = nullptr;
+    for (uint8_t i = 0; i < MQTT_QOS1_WINDOW && !slot; i++) {
+        if (!window[i].id) slot = &window[i];
+    }
+    if (!slot) return false; // Window full: the caller keeps the message
+
+    uint16_t id = nextId();
+    size_t n = frame(slot->packet, MQTT_PUBLISH | MQTT_PUBLISH_QOS1, topic, id, payload, length);
+    if (!n) return false;
+    slot->id = id;
+    slot->length = n;
+    slot->sentMs = halMillis();
+    write(slot->packet, n); // A failed write is sent again after the reconnect
+    return true;
+}
+
+bool Qos1Transport::subscribe(const char* topic) {
+    if (!connected()) return false;
+    size_t topicLength = strlen(topic);
+    size_t body = 2 + 2 + topicLength + 1;
+    if (1 + lengthBytes(body) + body > bufferSize) return false;
+    uint8_t* p = tx;
+    *p++ = MQTT_SUBSCRIBE;
+    p = putLength(p, body);
+    p = putU16(p, nextId());
+    p = putString(p, topic, topicLength);
+    *p++ = 0; // Requested QoS
+    return write(tx, p - tx);
+}
+
+uint8_t Qos1Transport::inFlight() const {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < MQTT_QOS1_WINDOW; i++) n += window[i].id != 0;
+    return n;
+}
@@ -0,0 +1,87 @@
+#ifndef QOS1_TRANSPORT_H
+#define QOS1_TRANSPORT_H
+
+#include "mqttTransport.h"
+
+#define MQTT_QOS1_WINDOW 4        // QoS 1 publishes in flight, publish() returns false when all are taken
+#define MQTT_QOS1_RETRY_MS 5000   // Unacknowledged publish is sent again (DUP) after this
+
+// Minimal MQTT 3.1.1 client with QoS 1 publishes that do not wait for their PUBACK.
+// A QoS 1 publish is copied into one of MQTT_QOS1_WINDOW slots and written; poll()
+// frees the slot when the PUBACK arrives and writes it again after MQTT_QOS1_RETRY_MS.
+// Slots survive a reconnect and are sent again right after it, so a message taken by
+// publish() reaches the broker at least once unless the device restarts first.
+//
+// Incoming packets are parsed as their bytes arrive: poll() never waits for the rest
+// of a packet. Packets larger than the buffer are skipped. Subscriptions are QoS 0.
+class Qos1Transport : public MqttTransport {
+public:
+    explicit Qos1Transport(Client& net);
+    ~Qos1Transport();
+
+    bool begin(const IPAddress& broker, uint16_t port, uint16_t bufferSize, uint16_t keepAliveS,
+               uint16_t socketTimeoutS, MessageCallback callback) override;
+    bool connect(const char* clientId, const char* user, const char* pass) override;
+    bool connected() override;
+    int state() override { return st; }
+    void poll() override;
+
+    bool subscribe(const char* topic) override;
+    bool publish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos = 0) override;
+
+    uint8_t inFlight() const override;
+    uint32_t getRetransmits() const override { return retransmits; }
+    uint32_t getRxSkipped() const { return rxSkipped; }
+
+private:
+    struct Slot {
+        uint16_t id;            // Packet id, 0 = free
+        uint16_t length;
+        unsigned long sentMs;
+        uint8_t* packet;        // bufferSize bytes, the complete PUBLISH packet
+    };
+
+    Client& net;
+    IPAddress broker;
+    uint16_t port;
+    uint16_t bufferSize;
+    uint16_t keepAliveS;
+    uint16_t socketTimeoutS;
+    MessageCallback callback;
+    int st;
+
+    uint8_t* memory;            // rx, tx and the window slots in one allocation
+    uint8_t* rx;
+    uint8_t* tx;
+    Slot window[MQTT_QOS1_WINDOW];
+    uint16_t lastId;
+    uint32_t retransmits;
+    uint32_t rxSkipped;
+
+    unsigned long lastOutMs;
+    unsigned long lastInMs;
+    bool pingOutstanding;
+
+    // Incoming packet parser: fixed header byte, remaining length, body into rx
+    enum RxState : uint8_t {
+        RX_HEADER,
+        RX_LENGTH,
+        RX_BODY,
+        RX_SKIP,    // Larger than the buffer
+    };
+    RxState rxState;
+    uint8_t rxHeader;
+    uint32_t rxLength;
+    uint32_t rxPos;
+    uint8_t rxShift;
+
+    bool readPacket();
+    void handlePacket();
+    bool write(const uint8_t* packet, size_t length);
+    void resend(Slot& slot);
+    void drop(int reason);
+    uint16_t nextId();
+    size_t frame(uint8_t* out, uint8_t header, const char* topic, uint16_t id, const uint8_t* payload, size_t length) const;
+};
+
+#endif // QOS1_TRANSPORT_H
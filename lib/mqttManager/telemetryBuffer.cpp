@@ -0,0 +1,150 @@
+#include "telemetryBuffer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+TelemetryBuffer::TelemetryBuffer(const TelemetryKey* keys, uint8_t count)
+    : keys(keys), keyCount(count < TELEMETRY_MAX_KEYS ? count : TELEMETRY_MAX_KEYS),
+      head(0), count(0), urgentPending(false), fullPending(true), lastFullMs(0), sampleCount(0), dropped(0) {
+    memset(lastValues, 0, sizeof(lastValues));
+}
+
+bool TelemetryBuffer::sample(const float* values, unsigned long nowMs) {
+    bool full = fullPending || nowMs - lastFullMs >= TELEMETRY_HEARTBEAT_MS;
+    uint32_t mask = 0;
+    bool urgent = false;
+    for (uint8_t i = 0; i < keyCount; i++) {
+        bool changed = fabsf(values[i] - lastValues[i]) > keys[i].deadband;
+        if (full || changed) mask |= 1UL << i;
+        if (changed && keys[i].urgent) urgent = true; // Also when it lands in a full sample
+    }
+    if (!mask) return false;
+
+    if (count == TELEMETRY_RING_SIZE) { // Overwrite the oldest
+        head = (head + 1) % TELEMETRY_RING_SIZE;
+        count--;
+        dropped++;
+    }
+    TelemetrySample& s = ring[(head + count) % TELEMETRY_RING_SIZE];
+    s.ms = nowMs;
+    s.mask = mask;
+    for (uint8_t i = 0; i < keyCount; i++) {
+        if (!(mask & (1UL << i))) continue;
+        s.values[i] = values[i];
+        lastValues[i] = values[i];
+    }
+    count++;
+    sampleCount++;
+
+    if (full) {
+        fullPending = false;
+        lastFullMs = nowMs;
+    }
+    if (urgent) urgentPending = true;
+    return true;
+}
+
+bool TelemetryBuffer::flushDue(unsigned long nowMs) const {
+    if (!count) return false;
+    return urgentPending || count >= TELEMETRY_BATCH_SAMPLES || nowMs - ring[head].ms >= TELEMETRY_FLUSH_MS;
+}
+
+size_t TelemetryBuffer::serialize(uint8_t* out, size_t size, PayloadEncoding encoding, int64_t nowEpochMs,
+                                  unsigned long nowMs, uint8_t& samples) const {
+    const TelemetrySample* batch[TELEMETRY_RING_SIZE];
+    int64_t ts[TELEMETRY_RING_SIZE];
+    for (uint8_t n = 0; n < count; n++) {
+        batch[n] = &peek(n);
+        ts[n] = sampleEpochMs(*batch[n], nowEpochMs, nowMs);
+    }
+    return encodeBatch(out, size, encoding, batch, ts, count, samples);
+}
+
+size_t TelemetryBuffer::encodeBatch(uint8_t* out, size_t size, PayloadEncoding encoding, const TelemetrySample* const* samples,
+                                    const int64_t* ts, uint8_t count, uint8_t& encoded) const {
+    encoded = 0;
+    if (encoding == ENCODING_MSGPACK) {
+        MsgPackWriter writer(out, size);
+        size_t header = writer.beginArray();
+        for (uint8_t n = 0; n < count; n++) {
+            size_t mark = writer.length();
+            packSample(writer, *samples[n], ts[n]);
+            if (writer.overflowed()) {
+                writer.rewind(mark);
+                break;
+            }
+            encoded++;
+        }
+        writer.endArray(header, encoded);
+        return encoded && !writer.overflowed() ? writer.length() : 0;
+    }
+
+    char* json = (char*)out;
+    if (size < 3) return 0;
+    size_t len = 1;
+    json[0] = '[';
+    for (uint8_t n = 0; n < count; n++) {
+        size_t sep = n ? 1 : 0;
+        if (len + sep + 2 >= size) break;
+        // Keep one byte for the closing bracket
+        size_t w = formatSample(json + len + sep, size - len - sep - 1, *samples[n], ts[n]);
+        if (!w) break;
+        if (sep) json[len] = ',';
+        len += sep + w;
+        encoded++;
+    }
+    json[len++] = ']';
+    json[len] = '\0';
+    return encoded ? len : 0;
+}
+
+int64_t TelemetryBuffer::sampleEpochMs(const TelemetrySample& s, int64_t nowEpochMs, unsigned long nowMs) {
+    if (!nowEpochMs) return 0;
+    return nowEpochMs - (int64_t)(nowMs - s.ms);
+}
+
+// Returns 0 when the sample does not fit into `size` (terminator included)
+size_t TelemetryBuffer::formatSample(char* out, size_t size, const TelemetrySample& s, int64_t ts) const {
+    int len;
+    if (ts) {
+        len = snprintf(out, size, "{\"ts\":%lld,\"values\":{", (long long)ts);
+    } else {
+        len = snprintf(out, size, "{");
+    }
+    bool first = true;
+    for (uint8_t i = 0; i < keyCount && len > 0 && (size_t)len < size; i++) {
+        if (!(s.mask & (1UL << i))) continue;
+        len += snprintf(out + len, size - len, "%s\"%s\":%.7g", first ? "" : ",", keys[i].key, s.values[i]);
+        first = false;
+    }
+    if (len > 0 && (size_t)len < size) len += snprintf(out + len, size - len, ts ? "}}" : "}");
+    if (len <= 0 || (size_t)len >= size) return 0;
+    return len;
+}
+
+void TelemetryBuffer::packSample(MsgPackWriter& writer, const TelemetrySample& s, int64_t ts) const {
+    if (ts) {
+        writer.mapHeader(2);
+        writer.str("ts", 2);
+        writer.integer(ts);
+        writer.str("values", 6);
+    }
+    uint8_t changed = 0;
+    for (uint8_t i = 0; i < keyCount; i++) {
+        if (s.mask & (1UL << i)) changed++;
+    }
+    writer.mapHeader(changed);
+    for (uint8_t i = 0; i < keyCount; i++) {
+        if (!(s.mask & (1UL << i))) continue;
+        writer.str(keys[i].key);
+        writer.number(s.values[i]);
+    }
+}
+
+void TelemetryBuffer::consume(uint8_t samples) {
+    if (samples > count) samples = count;
+    head = (head + samples) % TELEMETRY_RING_SIZE;
+    count -= samples;
+    if (!count) urgentPending = false;
+}
@@ -0,0 +1,77 @@
+#ifndef TELEMETRY_BUFFER_H
+#define TELEMETRY_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "payloadEncoding.h"
+
+#define TELEMETRY_MAX_KEYS 24
+#define TELEMETRY_RING_SIZE 32        // Samples held until published, oldest dropped when full
+#define TELEMETRY_FLUSH_MS 10000      // Oldest sample age that triggers a publish
+#define TELEMETRY_BATCH_SAMPLES 8     // Sample count that triggers a publish
+#define TELEMETRY_HEARTBEAT_MS 60000  // Every key is sent at least this often
+
+// One telemetry key: a new value is recorded when it moves more than `deadband` away
+// from the last recorded value; `urgent` keys (status codes) are published right away.
+struct TelemetryKey {
+    const char* key;
+    float deadband;
+    bool urgent;
+};
+
+// Sample of the changed keys only, stamped with millis() and converted to epoch time
+// when it is serialized, so samples taken before SNTP sync still get a correct ts
+struct TelemetrySample {
+    unsigned long ms;
+    uint32_t mask;  // Bit i set: values[i] was recorded
+    float values[TELEMETRY_MAX_KEYS];
+};
+
+// Ring of on-change telemetry samples, serialized as a ThingsBoard batch
+// [{"ts":..,"values":{..}}, ..]. Used from the network task only.
+class TelemetryBuffer {
+public:
+    TelemetryBuffer(const TelemetryKey* keys, uint8_t count);
+
+    // Records the keys that changed (or all of them when the heartbeat is due);
+    // returns true when something was recorded
+    bool sample(const float* values, unsigned long nowMs);
+    void requestFull() { fullPending = true; } // Next sample records every key
+
+    bool flushDue(unsigned long nowMs) const;
+    // Writes as many of the oldest samples as fit into `out`, nowEpochMs = 0 when the
+    // clock is not set (samples are then sent without ts and stamped by the server)
+    size_t serialize(uint8_t* out, size_t size, PayloadEncoding encoding, int64_t nowEpochMs, unsigned long nowMs,
+                     uint8_t& samples) const;
+    void consume(uint8_t samples);
+    const TelemetrySample& peek(uint8_t n) const { return ring[(head + n) % TELEMETRY_RING_SIZE]; } // n = 0: oldest
+
+    // Any samples (ring or journal) as one batch, ts = 0: no ts; `encoded` = samples that fit
+    size_t encodeBatch(uint8_t* out, size_t size, PayloadEncoding encoding, const TelemetrySample* const* samples,
+                       const int64_t* ts, uint8_t count, uint8_t& encoded) const;
+    static int64_t sampleEpochMs(const TelemetrySample& s, int64_t nowEpochMs, unsigned long nowMs);
+
+    uint8_t depth() const { return count; }
+    uint32_t getSampleCount() const { return sampleCount; }
+    uint32_t getDropped() const { return dropped; }
+
+private:
+    const TelemetryKey* keys;
+    uint8_t keyCount;
+
+    TelemetrySample ring[TELEMETRY_RING_SIZE];
+    uint8_t head;   // Oldest sample
+    uint8_t count;
+    bool urgentPending;
+
+    float lastValues[TELEMETRY_MAX_KEYS];
+    bool fullPending;
+    unsigned long lastFullMs;
+    uint32_t sampleCount;
+    uint32_t dropped;
+
+    size_t formatSample(char* out, size_t size, const TelemetrySample& s, int64_t ts) const;
+    void packSample(MsgPackWriter& writer, const TelemetrySample& s, int64_t ts) const;
+};
+
+#endif // TELEMETRY_BUFFER_H
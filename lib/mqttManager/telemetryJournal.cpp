@@ -0,0 +1,246 @@
+#include "telemetryJournal.h"
+#include "hal.h"
+
+#define JOURNAL_SEGMENT_MAGIC 0x4A4D4C54UL // "TLMJ"
+#define JOURNAL_RECORD_MAGIC 0xA7
+#define JOURNAL_BOOT_PATH "/tlmboot.bin"
+
+// Segment file: header, then records back to back
+struct JournalSegmentHeader {
+    uint32_t magic;
+    uint32_t generation; // Higher = newer segment
+};
+
+// Record: header, then `count` floats for the set bits of `mask`, lowest bit first
+struct JournalRecordHeader {
+    uint8_t magic;
+    uint8_t count;
+    uint8_t checksum; // Sum of boot, mask, ts and value bytes, catches a write torn by a reset
+    uint8_t boot;     // 0: ts is epoch ms. Else taken before the clock was set: ts is millis() of that boot
+    uint32_t mask;
+    int64_t ts;
+};
+
+static const uint32_t SEGMENT_HEADER_BYTES = sizeof(JournalSegmentHeader);
+static const uint32_t RECORD_HEADER_BYTES = sizeof(JournalRecordHeader);
+
+static uint8_t checksum(const JournalRecordHeader& header, const float* values) {
+    uint8_t sum = header.boot;
+    const uint8_t* p = (const uint8_t*)&header.mask;
+    for (uint8_t i = 0; i < sizeof(header.mask) + sizeof(header.ts); i++) sum += p[i];
+    p = (const uint8_t*)values;
+    for (uint16_t i = 0; i < header.count * sizeof(float); i++) sum += p[i];
+    return sum;
+}
+
+TelemetryJournal::TelemetryJournal()
+    : active(0), readSegment(0), readPos(SEGMENT_HEADER_BYTES), peekCount(0), written(0), droppedBytes(0),
+    untimedDropped(0), generation(0), bootId(0) {
+    size[0] = size[1] = 0;
+}
+
+const char* TelemetryJournal::segmentPath(uint8_t segment) {
+    return segment ? "/tlm1.bin" : "/tlm0.bin";
+}
+
+// Picks up what an earlier boot left behind; the read position starts over
+void TelemetryJournal::begin() {
+    uint32_t gen[2] = {0, 0};
+    for (uint8_t i = 0; i < 2; i++) {
+        size[i] = 0;
+        if (!halFS().exists(segmentPath(i))) continue;
+        File file = halFS().open(segmentPath(i), "r");
+        JournalSegmentHeader header;
+        if (file && file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && header.magic == JOURNAL_SEGMENT_MAGIC) {
+            size[i] = file.size();
+            gen[i] = header.generation;
+        }
+        file.close();
+        if (!size[i]) halFS().remove(segmentPath(i));
+    }
+
+    if (size[0] && size[1]) active = gen[0] > gen[1] ? 0 : 1;
+    else active = size[1] ? 1 : 0;
+    generation = gen[0] > gen[1] ? gen[0] : gen[1];
+
+    readSegment = size[1 - active] ? 1 - active : active;
+    readPos = SEGMENT_HEADER_BYTES;
+    peekCount = 0;
+
+    if (!isEmpty()) Serial.printf("[journal] %u bytes of telemetry waiting to be replayed\n", (unsigned)pendingBytes());
+}
+
+// Number of this boot in untimed records: assigned with the first one and counted on
+// flash, so records an earlier boot could not time are told apart from this boot's
+uint8_t TelemetryJournal::currentBoot() {
+    if (bootId) return bootId;
+    uint8_t last = 0;
+    if (halFS().exists(JOURNAL_BOOT_PATH)) {
+        File file = halFS().open(JOURNAL_BOOT_PATH, "r");
+        if (file) file.read(&last, 1);
+        file.close();
+    }
+    bootId = last == UINT8_MAX ? 1 : last + 1;
+    File file = halFS().open(JOURNAL_BOOT_PATH, "w");
+    if (file) file.write(&bootId, 1);
+    file.close();
+    return bootId;
+}
+
+uint32_t TelemetryJournal::pendingBytes() const {
+    if (readSegment == active) return size[active] > readPos ? size[active] - readPos : 0;
+    uint32_t bytes = size[readSegment] > readPos ? size[readSegment] - readPos : 0;
+    if (size[active] > SEGMENT_HEADER_BYTES) bytes += size[active] - SEGMENT_HEADER_BYTES;
+    return bytes;
+}
+
+bool TelemetryJournal::append(const TelemetrySample* const* samples, const int64_t* ts, uint8_t count) {
+    uint32_t bytes = 0;
+    for (uint8_t n = 0; n < count; n++) bytes += RECORD_HEADER_BYTES + __builtin_popcount(samples[n]->mask) * sizeof(float);
+    uint32_t base = size[active] ? size[active] : SEGMENT_HEADER_BYTES;
+    if (base + bytes > JOURNAL_SEGMENT_BYTES) rotate();
+
+    File file = halFS().open(segmentPath(active), "a");
+    if (!file) {
+        Serial.println("[journal] Failed to open journal for writing.");
+        return false;
+    }
+    if (!size[active]) {
+        JournalSegmentHeader header = {JOURNAL_SEGMENT_MAGIC, ++generation};
+        size[active] += file.write((const uint8_t*)&header, sizeof(header));
+    }
+
+    // One write per record, the whole batch in a single open/close
+    struct {
+        JournalRecordHeader header;
+        float values[TELEMETRY_MAX_KEYS];
+    } record;
+    for (uint8_t n = 0; n < count; n++) {
+        record.header = {JOURNAL_RECORD_MAGIC, 0, 0, 0, samples[n]->mask, ts[n]};
+        if (!ts[n]) { // Clock not set: keep the sample's millis() until this boot can resolve it
+            record.header.boot = currentBoot();
+            record.header.ts = samples[n]->ms;
+        }
+        for (uint8_t i = 0; i < TELEMETRY_MAX_KEYS; i++) {
+            if (record.header.mask & (1UL << i)) record.values[record.header.count++] = samples[n]->values[i];
+        }
+        record.header.checksum = checksum(record.header, record.values);
+        size[active] += file.write((const uint8_t*)&record, RECORD_HEADER_BYTES + record.header.count * sizeof(float));
+    }
+    file.close();
+    written += count;
+    return true;
+}
+
+// Active segment full: the older one is dropped (with whatever was not replayed yet)
+// and reused as the new active segment
+void TelemetryJournal::rotate() {
+    uint8_t older = 1 - active;
+    if (size[older]) {
+        uint32_t from = readSegment == older ? readPos : SEGMENT_HEADER_BYTES;
+        if (size[older] > from) droppedBytes += size[older] - from;
+        halFS().remove(segmentPath(older));
+        size[older] = 0;
+        Serial.printf("[journal] Full, oldest telemetry dropped (%u bytes so far)\n", (unsigned)droppedBytes);
+    }
+    if (readSegment == older) {
+        readSegment = active;
+        readPos = SEGMENT_HEADER_BYTES;
+    }
+    active = older;
+    peekCount = 0;
+}
+
+uint8_t TelemetryJournal::read(TelemetrySample* samples, int64_t* ts, uint8_t max, int64_t nowEpochMs, unsigned long nowMs) {
+    if (max > JOURNAL_REPLAY_RECORDS) max = JOURNAL_REPLAY_RECORDS;
+    uint8_t n = 0;
+    uint8_t segment = readSegment;
+    uint32_t pos = readPos;
+    File file;
+    bool open = false;
+
+    while (n < max) {
+        if (pos >= size[segment]) {
+            if (segment == active) break;
+            segment = active;
+            pos = SEGMENT_HEADER_BYTES;
+            if (open) file.close();
+            open = false;
+            continue;
+        }
+        if (!open) {
+            file = halFS().open(segmentPath(segment), "r");
+            if (!file) break;
+            file.seek(pos);
+            open = true;
+        }
+
+        JournalRecordHeader header;
+        float values[TELEMETRY_MAX_KEYS];
+        bool valid = file.read((uint8_t*)&header, RECORD_HEADER_BYTES) == RECORD_HEADER_BYTES &&
+                     header.magic == JOURNAL_RECORD_MAGIC && header.count <= TELEMETRY_MAX_KEYS &&
+                     __builtin_popcount(header.mask) == header.count &&
+                     file.read((uint8_t*)values, header.count * sizeof(float)) == header.count * sizeof(float) &&
+                     checksum(header, values) == header.checksum;
+        if (!valid) { // Torn or damaged tail: skip the rest of this segment
+            Serial.printf("[journal] Damaged record in %s at %u, skipped.\n", segmentPath(segment), (unsigned)pos);
+            pos = size[segment];
+            continue;
+        }
+
+        uint32_t next = pos + RECORD_HEADER_BYTES + header.count * sizeof(float);
+        if (header.boot && header.boot != bootId) { // An earlier boot's millis(): no way to date it now
+            if (n) break;
+            untimedDropped++;
+            Serial.printf("[journal] Untimed record from an earlier boot dropped (%u so far)\n", (unsigned)untimedDropped);
+            pos = next;
+            continue;
+        }
+        // Wait for the clock, keeping the order; past the wait it goes out without ts
+        if (header.boot && !nowEpochMs && nowMs < JOURNAL_CLOCK_WAIT_MS) break;
+        if (!n && (segment != readSegment || pos != readPos)) advanceTo(segment, pos); // Past skipped records for good
+
+        TelemetrySample& s = samples[n];
+        s.ms = header.boot ? (unsigned long)header.ts : 0;
+        s.mask = header.mask;
+        uint8_t v = 0;
+        for (uint8_t i = 0; i < TELEMETRY_MAX_KEYS; i++) {
+            if (header.mask & (1UL << i)) s.values[i] = values[v++];
+        }
+        ts[n] = header.boot ? TelemetryBuffer::sampleEpochMs(s, nowEpochMs, nowMs) : header.ts;
+        pos = next;
+        peekSegment[n] = segment;
+        peekPos[n] = pos;
+        n++;
+    }
+    if (open) file.close();
+
+    // Only damaged records ahead: nothing worth keeping, move past them now
+    if (!n && (segment != readSegment || pos != readPos)) advanceTo(segment, pos);
+
+    peekCount = n;
+    return n;
+}
+
+void TelemetryJournal::commitRead(uint8_t records) {
+    if (records > peekCount) records = peekCount;
+    if (!records) return;
+    advanceTo(peekSegment[records - 1], peekPos[records - 1]);
+    peekCount = 0;
+}
+
+void TelemetryJournal::advanceTo(uint8_t segment, uint32_t pos) {
+    if (segment != readSegment) { // Older segment fully replayed
+        halFS().remove(segmentPath(readSegment));
+        size[readSegment] = 0;
+    }
+    readSegment = segment;
+    readPos = pos;
+
+    // Everything replayed: drop the file so the flash space (and a replay after reboot) goes away
+    if (readSegment == active && size[active] && readPos >= size[active]) {
+        halFS().remove(segmentPath(active));
+        size[active] = 0;
+        readPos = SEGMENT_HEADER_BYTES;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef TELEMETRY_JOURNAL_H
+#define TELEMETRY_JOURNAL_H
+
+#include <Arduino.h>
+#include "telemetryBuffer.h"
+
+#define JOURNAL_SEGMENT_BYTES 16384      // Two segments, the older one is dropped when both are full
+#define JOURNAL_REPLAY_INTERVAL_MS 1000  // One replay batch per interval after reconnect
+#define JOURNAL_REPLAY_RECORDS 8         // Records read per replay batch
+#define JOURNAL_CLOCK_WAIT_MS 600000UL   // Uptime after which untimed records stop waiting for SNTP
+
+// Bounded append-only journal of telemetry samples that could not be published, on
+// LittleFS. Records are binary and carry their epoch ts, so replaying one twice (after
+// a reboot the read position starts over) just rewrites the same point on the server.
+//
+// Two segment files take turns: appends go to the active one, reads start in the older
+// one, which is deleted once replayed. Nothing is rewritten in place, and callers append
+// samples in batches, so flash sees one append per batch rather than one per sample.
+//
+// A sample taken before the clock was set (SNTP not synced yet) has no epoch ts. It is
+// journaled with its millis() and the boot it was taken in, and replayed once the clock
+// is set in that same boot, with the ts it should have had. Replay waits at such a record
+// until then, but only for the first JOURNAL_CLOCK_WAIT_MS of uptime: where SNTP never
+// syncs (LAN-only broker) it is then replayed without ts, stamped by the server, so it
+// does not hold back the records behind it. An untimed record left by an earlier boot
+// cannot be dated any more and is dropped (getUntimedDropped()) rather than sent without
+// ts, which would stamp it with the replay time.
+// Used from the network task only.
+class TelemetryJournal {
+public:
+    TelemetryJournal();
+    void begin(); // LittleFS must be mounted
+
+    // Appends `count` samples with their epoch ts (0 = clock not set, the sample's ms is
+    // kept instead); false if the file could not be written
+    bool append(const TelemetrySample* const* samples, const int64_t* ts, uint8_t count);
+
+    // Reads up to `max` (at most JOURNAL_REPLAY_RECORDS) records from the read position
+    // without consuming them, with their epoch ts (nowEpochMs = 0: clock not set; ts = 0
+    // once JOURNAL_CLOCK_WAIT_MS has passed without it); commitRead() then consumes the
+    // first `records` of them
+    uint8_t read(TelemetrySample* samples, int64_t* ts, uint8_t max, int64_t nowEpochMs, unsigned long nowMs);
+    void commitRead(uint8_t records);
+
+    bool isEmpty() const { return pendingBytes() == 0; }
+    uint32_t pendingBytes() const;
+    uint32_t getWritten() const { return written; }
+    uint32_t getDroppedBytes() const { return droppedBytes; }
+    uint32_t getUntimedDropped() const { return untimedDropped; }
+
+private:
+    uint32_t size[2];     // Bytes in each segment file
+    uint8_t active;       // Segment being appended to, the other one is older
+    uint8_t readSegment;
+    uint32_t readPos;
+    uint8_t peekSegment[JOURNAL_REPLAY_RECORDS]; // Read position after each record of the last read()
+    uint32_t peekPos[JOURNAL_REPLAY_RECORDS];
+    uint8_t peekCount;
+    uint32_t written;     // Records
+    uint32_t droppedBytes;
+    uint32_t untimedDropped;
+    uint32_t generation;  // Of the newest segment
+    uint8_t bootId;       // 0 until this boot journals an untimed record
+
+    static const char* segmentPath(uint8_t segment);
+    uint8_t currentBoot();
+    void rotate();
+    void advanceTo(uint8_t segment, uint32_t pos);
+};
+
+#endif // TELEMETRY_JOURNAL_H
@@ -0,0 +1,193 @@
+#include "tokenSequencer.h"
+
+extern MotorController motorController;
+
+TokenSequencer* TokenSequencer::_instance = nullptr;
+
+TokenSequencer::TokenSequencer()
+    : actionCount(0), nextAction(0), pressCount(0), estimatedMs(0), startMs(0), finishedMs(0),
+    active(false), failed(false), waiting(false), actionDone(false), actionFailed(false) {
+    _instance = this;
+}
+
+//* COMPILER
+bool TokenSequencer::compile(const String& token, bool submit) {
+    if (active) {
+        Serial.println("[token] Cannot compile while a token is running.");
+        return false;
+    }
+
+    actionCount = 0;
+    pressCount = 0;
+    estimatedMs = 0;
+
+    steps_t position = motorController.getPositionSteps();
+    if (motorController.needsHoming()) {
+        TokenAction home = {ACTION_HOME, 0, 0, 0};
+        if (!addAction(home)) return false;
+        position = 0;
+    }
+
+    int lastButton = -1;
+    for (size_t i = 0; i < token.length(); i++) {
+        char c = token[i];
+        int button;
+        if (isdigit(static_cast<unsigned char>(c))) button = c - '0';
+        else if (c == TOKEN_CHAR_BACKSPACE) button = BUTTON_BACKSPACE;
+        else if (c == TOKEN_CHAR_SUBMIT) button = BUTTON_SUBMIT;
+        else continue; // separators such as spaces or dashes
+
+        if (!addPress(button, position)) return false;
+        lastButton = button;
+    }
+
+    if (pressCount == 0) {
+        Serial.println("[token] Token contains no keys.");
+        return false;
+    }
+
+    if (submit && lastButton != BUTTON_SUBMIT) {
+        if (!addPress(BUTTON_SUBMIT, position)) return false;
+    }
+
+    // Return home after input
+    if (position != 0) {
+        TokenAction home = {ACTION_MOVE, 0, 0, 0};
+        if (!addAction(home)) return false;
+    }
+
+    estimate();
+    return true;
+}
+
+bool TokenSequencer::addPress(int button, steps_t& position) {
+    steps_t target;
+    const KeyBinding* key = motorController.resolveButton(button, target);
+    if (!key) return false;
+
+    // Consecutive keys on the same row need no move
+    if (target != position) {
+        TokenAction move = {ACTION_MOVE, 0, 0, target};
+        if (!addAction(move)) return false;
+        position = target;
+    }
+
+    TokenAction press = {ACTION_PRESS, (uint8_t)button, key->servo, 0};
+    if (!addAction(press)) return false;
+    pressCount++;
+    return true;
+}
+
+bool TokenSequencer::addAction(const TokenAction& action) {
+    if (actionCount >= MAX_TOKEN_ACTIONS) {
+        Serial.println("[token] Token too long.");
+        return false;
+    }
+    actions[actionCount++] = action;
+    return true;
+}
+
+void TokenSequencer::estimate() {
+    steps_t position = motorController.getPositionSteps();
+    estimatedMs = 0;
+
+    for (uint8_t i = 0; i < actionCount; i++) {
+        const TokenAction& a = actions[i];
+        switch (a.type) {
+            case ACTION_HOME:
+                estimatedMs += motorController.getHomingDurationMs(); // last measured run, 0 if never homed
+                position = 0;
+                break;
+            case ACTION_MOVE:
+                estimatedMs += motorController.estimateMoveUs(labs(a.targetSteps - position)) / 1000 + MOVE_SETTLE_MS;
+                position = a.targetSteps;
+                break;
+            case ACTION_PRESS: {
+                // A press finishes once the plunger is clear; the same servo pressing
+                // next also waits for the rest of its return
+                const ServoProfile* p = motorController.getServoProfile(a.servo);
+                if (!p) break;
+                const KeyBinding& key = getKeypadLayout().keys[a.button];
+                bool sameServoNext = (i + 1 < actionCount) && actions[i + 1].type == ACTION_PRESS &&
+                                     actions[i + 1].servo == a.servo;
+                estimatedMs += p->pressMs + (key.holdMs ? key.holdMs : p->holdMs) +
+                               (sameServoNext ? p->releaseMs : p->clearMs);
+                break;
+            }
+        }
+    }
+}
+
+//* EXECUTOR
+bool TokenSequencer::start() {
+    if (active || actionCount == 0) return false;
+
+    nextAction = 0;
+    failed = false;
+    waiting = false;
+    startMs = halMillis();
+    active = true;
+    return true;
+}
+
+bool TokenSequencer::update() {
+    if (!active) return false;
+
+    if (waiting) {
+        if (!actionDone) return false;
+        waiting = false;
+        if (actionFailed) {
+            finish(false);
+            return true;
+        }
+    }
+
+    if (nextAction >= actionCount) {
+        finish(true);
+        return true;
+    }
+
+    // Flags are armed first because the motor may complete the action synchronously
+    waiting = true;
+    actionDone = false;
+    actionFailed = false;
+    if (!startAction(actions[nextAction++])) {
+        waiting = false;
+        finish(false);
+        return true;
+    }
+    return false;
+}
+
+bool TokenSequencer::startAction(const TokenAction& action) {
+    switch (action.type) {
+        case ACTION_HOME:
+            return motorController.calibrateAsync(_onActionFinished);
+        case ACTION_MOVE:
+            return motorController.moveToStepsAsync(action.targetSteps, _onActionFinished);
+        case ACTION_PRESS:
+            Serial.printf("[token] Pressing button %d\n", action.button);
+            return motorController.pressKeyAsync(getKeypadLayout().keys[action.button], _onActionFinished);
+    }
+    return false;
+}
+
+void TokenSequencer::abort() {
+    if (!active) return;
+    Serial.println("[token] Token entry aborted.");
+    finish(false);
+}
+
+void TokenSequencer::finish(bool ok) {
+    active = false;
+    failed = !ok;
+    finishedMs = halMillis();
+    Serial.printf("[token] %s: %u keys in %lu ms (estimated %lu ms)\n", ok ? "Done" : "Failed",
+                  pressCount, finishedMs - startMs, estimatedMs);
+}
+
+void TokenSequencer::_onActionFinished(MotionStatus status) {
+    if (!_instance) return;
+    _instance->actionFailed = (status != MOTION_DONE);
+    _instance->actionDone = true;
+}
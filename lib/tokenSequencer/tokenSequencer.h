@@ -0,0 +1,71 @@
+#ifndef TOKEN_SEQUENCER_H
+#define TOKEN_SEQUENCER_H
+
+#include <Arduino.h>
+#include "motorController.h"
+
+#define MAX_TOKEN_ACTIONS 96
+#define BUTTON_BACKSPACE 10
+#define BUTTON_SUBMIT 11
+#define TOKEN_CHAR_BACKSPACE '<' // Presses button 10 when it appears in a kodetoken
+#define TOKEN_CHAR_SUBMIT '#'    // Presses button 11 when it appears in a kodetoken
+#define TOKEN_AUTO_SUBMIT false  // Append a submit press when the kodetoken has no '#'
+
+enum TokenActionType : uint8_t {
+    ACTION_HOME,
+    ACTION_MOVE,
+    ACTION_PRESS,
+};
+
+struct TokenAction {
+    TokenActionType type;
+    uint8_t button;          // ACTION_PRESS: keypad button, index into the keypad layout
+    uint8_t servo;           // ACTION_PRESS
+    steps_t targetSteps;     // ACTION_MOVE
+};
+
+// Compiles a kodetoken into a timeline of homing, row moves and servo presses,
+// then runs it one action at a time through the async MotorController API.
+// Moves to the row the carriage is already on are dropped. Servo returns overlap
+// with the next action (see ServoEngine), only the same servo pressing again waits.
+class TokenSequencer {
+public:
+    TokenSequencer();
+
+    bool compile(const String& token, bool submit = TOKEN_AUTO_SUBMIT);
+    bool start();
+    bool update(); // Returns true once, when the program has finished or failed
+    void abort();
+
+    bool isActive() const { return active; }
+    bool succeeded() const { return !failed; }
+    uint8_t getActionCount() const { return actionCount; }
+    uint8_t getPressCount() const { return pressCount; }
+    unsigned long getEstimatedMs() const { return estimatedMs; }
+    unsigned long getElapsedMs() const { return (active ? halMillis() : finishedMs) - startMs; }
+
+private:
+    TokenAction actions[MAX_TOKEN_ACTIONS];
+    uint8_t actionCount;
+    uint8_t nextAction;
+    uint8_t pressCount;
+    unsigned long estimatedMs;
+    unsigned long startMs;
+    unsigned long finishedMs;
+    bool active;
+    bool failed;
+    bool waiting;
+    volatile bool actionDone;
+    volatile bool actionFailed;
+
+    bool addPress(int button, steps_t& position);
+    bool addAction(const TokenAction& action);
+    void estimate();
+    bool startAction(const TokenAction& action);
+    void finish(bool ok);
+
+    static TokenSequencer* _instance;
+    static void _onActionFinished(MotionStatus status);
+};
+
+#endif // TOKEN_SEQUENCER_H
@@ -13,23 +13,23 @@ void WifiManager::init(const String& ssid, const String& password) {
 void WifiManager::connect() {
     Serial.print("Connecting to WiFi...");
 
-    WiFi.mode(WIFI_STA);
-    WiFi.disconnect(true);
-    delay(200);
+    halWiFi().mode(WIFI_STA);
+    halWiFi().disconnect(true);
+    halDelay(200);
 
-    WiFi.begin(ssid.c_str(), password.c_str());
-    unsigned long startAttemptTime = millis();
+    halWiFi().begin(ssid.c_str(), password.c_str());
+    unsigned long startAttemptTime = halMillis();
 
-    while (WiFi.status() != WL_CONNECTED && millis() - startAttemptTime < 10000) {
-        delay(1000);
+    while (halWiFi().status() != WL_CONNECTED && halMillis() - startAttemptTime < 10000) {
+        halDelay(1000);
         Serial.print(".");
     }
     Serial.println();
 
-    if (WiFi.status() == WL_CONNECTED) {
+    if (halWiFi().status() == WL_CONNECTED) {
         Serial.println("Successfully connected to WiFi.");
         Serial.println("WiFi SSID: " + ssid);
-        Serial.println("WiFi IP Address: " + WiFi.localIP().toString() + "\n");
+        Serial.println("WiFi IP Address: " + halWiFi().localIP().toString() + "\n");
     } else {
         Serial.println("Failed connecting to WiFi.\n");
     }
@@ -37,7 +37,7 @@ void WifiManager::connect() {
 
 void WifiManager::disconnect() {
     Serial.println("Disconnecting from WiFi...");
-    WiFi.disconnect();
+    halWiFi().disconnect();
     Serial.println("Disconnected from WiFi.\n");
 }
 
@@ -49,7 +49,7 @@ void WifiManager::setCredentials(const String& new_ssid, const String& new_passw
 
 //* Getters
 bool WifiManager::getConnectionStatus() const {
-    return WiFi.status() == WL_CONNECTED;
+    return halWiFi().status() == WL_CONNECTED;
 }
 
 String WifiManager::getSSID() const {
@@ -61,11 +61,11 @@ String WifiManager::getPassword() const {
 }
 
 String WifiManager::getIPAddress() const {
-    return WiFi.localIP().toString();
+    return halWiFi().localIP().toString();
 }
 
 String WifiManager::getMACAddress() const {
-    return WiFi.macAddress();
+    return halWiFi().macAddress();
 }
 
 // simple URL-decode helper
@@ -94,28 +94,28 @@ void WifiManager::apMode() {
     IPAddress apIP(192,168,4,1);
     IPAddress netMsk(255,255,255,0);
 
-    WiFi.disconnect(true);
-    WiFi.mode(WIFI_OFF);
-    delay(200);
+    halWiFi().disconnect(true);
+    halWiFi().mode(WIFI_OFF);
+    halDelay(200);
 
-    WiFi.mode(WIFI_AP_STA);
-    WiFi.softAPConfig(apIP, apIP, netMsk);
-    WiFi.softAP(AP_SSID);
+    halWiFi().mode(WIFI_AP_STA);
+    halWiFi().softAPConfig(apIP, apIP, netMsk);
+    halWiFi().softAP(AP_SSID);
     Serial.println("Access Point started.");
 
-    IPAddress ip = WiFi.softAPIP();
+    IPAddress ip = halWiFi().softAPIP();
     Serial.print("AP IP Address: ");
     Serial.println(ip);
 
     // DNS server to redirect all queries to our AP IP
     const byte DNS_PORT = 53;
-    DNSServer dnsServer;
+    HalDnsServer dnsServer;
     dnsServer.start(DNS_PORT, "*", apIP);
 
     // Scan networks for the dropdown
     Serial.println("Scanning for available networks...\n");
-    delay(500);
-    int n = WiFi.scanNetworks();
+    halDelay(500);
+    int n = halWiFi().scanNetworks();
 
     if (n == -2){
         Serial.println("Scan Failed, retrying AP Mode");
@@ -130,8 +130,8 @@ void WifiManager::apMode() {
     networksHtml.reserve(1024);
     networksHtml += "<option value=\"\">-- Select network --</option>\n";
     for (int i = 0; i < n; ++i) {
-        String ss = WiFi.SSID(i);
-        int rssi = WiFi.RSSI(i);
+        String ss = halWiFi().SSID(i);
+        int rssi = halWiFi().RSSI(i);
         String enc = ss; // browser will URL-encode
         networksHtml += "<option value=\"";
         networksHtml += enc;
@@ -142,7 +142,7 @@ void WifiManager::apMode() {
         networksHtml += " dBm)</option>\n";
     }
 
-    WiFiServer server(80);
+    HalNetServer server(80);
     server.begin();
     Serial.println("Provisioning server started on port 80. Connect to AP and captive portal will open.");
 
@@ -150,9 +150,9 @@ void WifiManager::apMode() {
     while (true) {
         dnsServer.processNextRequest();  // handle DNS
 
-        WiFiClient client = server.available();
+        HalNetClient client = server.available();
         if (!client) {
-            delay(10); // yield to RTOS / WDT
+            halDelay(10); // yield to RTOS / WDT
             continue;
         }
 
@@ -200,8 +200,11 @@ void WifiManager::apMode() {
 
             if (newSsid.length()) {
                 setCredentials(newSsid, newPass);
-                setWiFiCredentials(newSsid, newPass);
-                fsManager.saveConfig();
+                {
+                    DeviceConfigLock lock;
+                    setWiFiCredentials(newSsid, newPass);
+                    fsManager.saveConfig();
+                }
                 Serial.println("Saved new WiFi credentials:");
                 Serial.println("SSID: " + newSsid);
                 Serial.print("Password: ");
@@ -214,8 +217,8 @@ void WifiManager::apMode() {
             client.printf("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: %u\r\nConnection: close\r\n\r\n%s",
                           (unsigned)body.length(), body.c_str());
             client.stop();
-            delay(250);
-            ESP.restart();
+            halDelay(250);
+            halRestart();
             return;
         }
 
@@ -2,8 +2,7 @@
 #define WIFI_MANAGER_H
 
 #include <Arduino.h>
-#include <WiFi.h>
-#include <DNSServer.h>
+#include "hal.h"
 
 #define AP_SSID "APTL"
 
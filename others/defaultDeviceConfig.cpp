@@ -21,6 +21,7 @@ static std::map<int, float> lineCoordinates = {     //* Set when saving config f
     {3, 0.0},
     {4, 0.0},
 };
+static KeypadLayout keypadLayout = DEFAULT_KEYPAD_LAYOUT; //* Overridden by "keypad" in config.json for other meter models
 
 //* FUNCTIONS
 void printConfig() {
@@ -41,6 +42,8 @@ void printConfig() {
         Serial.print(pair.second);
         Serial.println(" mm");
     }
+    Serial.print("Keypad Buttons: ");
+    Serial.println(keypadLayout.buttonCount);
     Serial.println("================================");
 }
 
@@ -59,8 +62,9 @@ void setMaxPosition(float mm) {
     if (mm > 0) { maxPosition = mm; }
 }
 void setLineCoordinates(const std::map<int,float>& coords) { lineCoordinates = coords; }
+void setKeypadLayout(const KeypadLayout& layout) { keypadLayout = layout; }
 void setLineCoordinate(int line, float coordinate) {
-    if (line <= 0 || line > 4) return;
+    if (line <= 0 || line > KEYPAD_MAX_LINES) return;
     if (coordinate < 0.0f) coordinate = 0.0f;
     lineCoordinates[line] = coordinate;
 }
@@ -75,4 +79,5 @@ const std::map<int, float>& getLineCoordinates() { return lineCoordinates; }
 float getLineCoordinate(int line) {
     auto it = lineCoordinates.find(line);
     return (it == lineCoordinates.end()) ? NAN : it->second;
-}
\ No newline at end of file
+}
+const KeypadLayout& getKeypadLayout() { return keypadLayout; }
\ No newline at end of file
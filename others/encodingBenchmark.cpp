@@ -0,0 +1,164 @@
+//! HOST BENCHMARK, NOT PART OF THE FIRMWARE BUILD
+// JSON vs MessagePack for the payloads the device sends and receives: telemetry batches
+// (encoded by TelemetryBuffer) and a shared-attribute push (decoded through the same
+// filter as MqttManager). Also checks the backend contract from payloadEncoding.h: the
+// MessagePack payload decodes to the same document as the JSON one.
+//
+// ArduinoJson comes from the PlatformIO library folder, so build the firmware once first:
+//   g++ -O2 -std=gnu++11 -Ilib/mqttManager -I.pio/libdeps/esp32doit-devkit-v1/ArduinoJson/src \
+//       others/encodingBenchmark.cpp lib/mqttManager/telemetryBuffer.cpp -o encodingBenchmark
+//   ./encodingBenchmark
+// Host timings only rank the encodings; on the ESP32 multiply by roughly 10-20.
+
+#include <ArduinoJson.h>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include "telemetryBuffer.h"
+
+// Same keys, order and deadbands as MqttManager::TELEMETRY_KEYS (APTL_MOTION_STATS on)
+static const TelemetryKey KEYS[] = {
+    {"posisi", 0.5f, false},    {"statusaptl", 0, true},  {"estop", 0, true},      {"stoplatency", 0, false},
+    {"homingms", 0, false},     {"homingrep", 0, false},  {"cmdq", 0, false},      {"cmdqmax", 0, false},
+    {"cmdqdrop", 0, false},     {"rxparseus", 100, false}, {"rxparsemax", 0, false}, {"rxdrop", 0, false},
+    {"mqttconn", 0, false},     {"mqttconnms", 0, false}, {"mqttdisc", 0, false},  {"tlmdrop", 0, false},
+    {"tlmjournal", 256, false}, {"tokens", 0, false},     {"tokenfail", 0, false}, {"jitp99", 2, false},
+    {"jitmax", 0, false},       {"movesps", 50, false},
+};
+static const uint8_t KEY_COUNT = sizeof(KEYS) / sizeof(KEYS[0]);
+
+static const int64_t EPOCH_MS = 1760000000000LL;
+static const int ITERATIONS = 20000;
+
+// A shared-attribute push as ThingsBoard sends it after a keypad change
+static const char ATTRIBUTE_PUSH[] =
+    "{\"shared\":{\"kodetoken\":\"12345678901234567890\",\"home\":0,\"up\":0,\"down\":0,\"press1\":0,\"press2\":0,"
+    "\"press3\":0,\"stop\":0,\"setmax\":0,\"row1\":1,\"row2\":0,\"row3\":0,\"row4\":0,\"newssid\":\"\",\"newpass\":\"\","
+    "\"keypad\":[[4,2],[1,1],[1,2],[1,3],[2,1],[2,2],[2,3],[3,1],[3,2],[3,3],[4,1,30,120],[4,3]],"
+    "\"dashboardLayout\":{\"theme\":\"dark\",\"widgets\":[1,2,3,4,5,6,7,8]},\"description\":\"Meter 7, block C\"}}";
+
+template <class F>
+static double nsPerCall(F f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ITERATIONS;
+}
+
+// Deep compare; MessagePack carries float32, so numbers match to float precision
+static bool sameDocument(JsonVariantConst a, JsonVariantConst b) {
+    if (a.is<JsonObjectConst>()) {
+        JsonObjectConst oa = a.as<JsonObjectConst>(), ob = b.as<JsonObjectConst>();
+        if (!b.is<JsonObjectConst>() || oa.size() != ob.size()) return false;
+        for (JsonPairConst kv : oa) {
+            if (!sameDocument(kv.value(), ob[kv.key()])) return false;
+        }
+        return true;
+    }
+    if (a.is<JsonArrayConst>()) {
+        JsonArrayConst aa = a.as<JsonArrayConst>(), ab = b.as<JsonArrayConst>();
+        if (!b.is<JsonArrayConst>() || aa.size() != ab.size()) return false;
+        for (size_t i = 0; i < aa.size(); i++) {
+            if (!sameDocument(aa[i], ab[i])) return false;
+        }
+        return true;
+    }
+    if (a.is<double>() && b.is<double>()) {
+        double x = a.as<double>(), y = b.as<double>();
+        return fabs(x - y) <= 1e-6 * fmax(1.0, fabs(x));
+    }
+    return a == b;
+}
+
+struct Row {
+    const char* name;
+    size_t jsonBytes, packBytes;
+    double jsonEncodeNs, packEncodeNs, jsonDecodeNs, packDecodeNs;
+    bool contract;
+};
+
+static void printRow(const Row& r) {
+    printf("%-22s %6u %6u %5.0f%% | %8.0f %8.0f | %8.0f %8.0f | %s\n", r.name, (unsigned)r.jsonBytes, (unsigned)r.packBytes,
+           100.0 * r.packBytes / r.jsonBytes, r.jsonEncodeNs, r.packEncodeNs, r.jsonDecodeNs, r.packDecodeNs,
+           r.contract ? "same" : "DIFFERENT");
+}
+
+// Telemetry: encode on the device, decode on the backend
+static Row telemetryRow(const char* name, const TelemetryBuffer& buffer, unsigned long nowMs) {
+    static uint8_t json[4096], pack[4096];
+    uint8_t samples;
+    Row r = {name, 0, 0, 0, 0, 0, 0, false};
+    r.jsonBytes = buffer.serialize(json, sizeof(json), ENCODING_JSON, EPOCH_MS, nowMs, samples);
+    r.packBytes = buffer.serialize(pack, sizeof(pack), ENCODING_MSGPACK, EPOCH_MS, nowMs, samples);
+    r.jsonEncodeNs = nsPerCall([&] { buffer.serialize(json, sizeof(json), ENCODING_JSON, EPOCH_MS, nowMs, samples); });
+    r.packEncodeNs = nsPerCall([&] { buffer.serialize(pack, sizeof(pack), ENCODING_MSGPACK, EPOCH_MS, nowMs, samples); });
+
+    JsonDocument a, b;
+    r.jsonDecodeNs = nsPerCall([&] { deserializeJson(a, json, r.jsonBytes); });
+    r.packDecodeNs = nsPerCall([&] { deserializeMsgPack(b, pack, r.packBytes); });
+    r.contract = sameDocument(a.as<JsonVariantConst>(), b.as<JsonVariantConst>());
+    return r;
+}
+
+// Attributes: encoded by the backend, decoded on the device through the attribute filter
+static Row attributeRow() {
+    static uint8_t pack[2048];
+    Row r = {"attribute push", 0, 0, 0, 0, 0, 0, false};
+
+    JsonDocument source;
+    deserializeJson(source, ATTRIBUTE_PUSH);
+    r.jsonBytes = strlen(ATTRIBUTE_PUSH);
+    r.packBytes = serializeMsgPack(source, pack, sizeof(pack));
+    r.jsonEncodeNs = nsPerCall([&] { static char out[2048]; serializeJson(source, out, sizeof(out)); });
+    r.packEncodeNs = nsPerCall([&] { serializeMsgPack(source, pack, sizeof(pack)); });
+
+    JsonDocument filter;
+    const char* keys[] = {"kodetoken", "home", "up", "down", "press1", "press2", "press3", "stop",
+                          "setmax", "row1", "row2", "row3", "row4", "newssid", "newpass", "keypad"};
+    for (const char* key : keys) {
+        filter[key] = true;
+        filter["shared"][key] = true;
+    }
+    JsonDocument a, b;
+    r.jsonDecodeNs = nsPerCall([&] { deserializeJson(a, ATTRIBUTE_PUSH, r.jsonBytes, DeserializationOption::Filter(filter)); });
+    r.packDecodeNs = nsPerCall([&] { deserializeMsgPack(b, pack, r.packBytes, DeserializationOption::Filter(filter)); });
+    r.contract = sameDocument(a.as<JsonVariantConst>(), b.as<JsonVariantConst>());
+    return r;
+}
+
+int main() {
+    float v[KEY_COUNT];
+    for (uint8_t i = 0; i < KEY_COUNT; i++) v[i] = 0;
+
+    // Heartbeat: every key once
+    TelemetryBuffer heartbeat(KEYS, KEY_COUNT);
+    v[0] = 37.4f;
+    v[3] = 812;
+    v[4] = 4210;
+    v[12] = 3;
+    v[13] = 146;
+    v[19] = 6;
+    v[20] = 41;
+    v[21] = 2400;
+    heartbeat.sample(v, 0);
+
+    // Move: eight 1 s samples of a moving carriage and a status change
+    TelemetryBuffer move(KEYS, KEY_COUNT);
+    move.sample(v, 0);
+    move.consume(move.depth());
+    for (int s = 1; s <= 8; s++) {
+        v[0] = 37.4f + s * 6.1f;
+        v[1] = s == 1 ? 12 : (s == 8 ? 0 : 12);
+        v[6] = s & 1;
+        v[9] = 180 + 130 * (s & 1);
+        move.sample(v, s * 1000);
+    }
+
+    printf("%-22s %6s %6s %6s | %8s %8s | %8s %8s | %s\n", "payload", "json", "mpack", "ratio", "enc json", "enc mp",
+           "dec json", "dec mp", "document");
+    printf("%-22s %6s %6s %6s | %8s %8s | %8s %8s |\n", "", "bytes", "bytes", "", "ns", "ns", "ns", "ns");
+    printRow(telemetryRow("telemetry heartbeat", heartbeat, 1000));
+    printRow(telemetryRow("telemetry move batch", move, 9000));
+    printRow(attributeRow());
+    return 0;
+}
@@ -16,16 +16,31 @@ static uint8_t wifiFailedReconnects = 0;
 static const uint8_t MAX_WIFI_FAILED_RECONNECTS = 5;
 const unsigned long WIFI_RECONNECT_INTERVAL = 5000;
 
-static unsigned long lastMqttAttempt = 0;
-static unsigned long lastMqttSubReq = 0;
 static unsigned long lastMqttSubLog = 0;
 static unsigned long lastMqttPub    = 0;
 
-const unsigned long MQTT_RECONNECT_INTERVAL = 3000;
-const unsigned long MQTT_PUB_INTERVAL       = 1000;  // kirim telemetry tiap 1s
-const unsigned long MQTT_SUB_POLL_INTERVAL  = 5000;  // request shared attrs tiap 5s (selain push)
+const unsigned long MQTT_PUB_INTERVAL       = 1000;  // sample telemetry tiap 1s, dikirim per batch
 const unsigned long MQTT_SUB_LOG_INTERVAL   = 2000;  // log status SUB tiap 2s
 
+// Tasks: motion next to the loop task on the app core, networking next to the WiFi stack
+static const BaseType_t MOTION_TASK_CORE      = 1;
+static const BaseType_t NETWORK_TASK_CORE     = 0;
+static const UBaseType_t MOTION_TASK_PRIORITY = 5;  // above networking, below the WiFi driver
+static const UBaseType_t NETWORK_TASK_PRIORITY = 2;
+static const uint32_t MOTION_TASK_STACK       = 6144;
+static const uint32_t NETWORK_TASK_STACK      = 8192;
+static const TickType_t MOTION_ACTIVE_PERIOD  = pdMS_TO_TICKS(1);  // while moving or running commands
+static const TickType_t MOTION_IDLE_PERIOD    = pdMS_TO_TICKS(20); // new commands wake the task early
+static const TickType_t NETWORK_PERIOD        = pdMS_TO_TICKS(5);
+
+static TaskHandle_t motionTaskHandle = nullptr;
+static TaskHandle_t networkTaskHandle = nullptr;
+
+static void motionTask(void* param);
+static void networkTask(void* param);
+static void networkLoop();
+static void handleSerialCommand();
+
 
 //* Main Program
 void setup() {
@@ -55,16 +70,46 @@ void setup() {
 
     //* Initializing Motor Controller
     motorController.setup();
-    motorController.calibrate();
+    if (motorController.needsHoming()) motorController.calibrate(); // skipped when the position survived a clean reboot
 
     //* Check Current Config
     printConfig();
+
+    //* Starting Tasks
+    xTaskCreatePinnedToCore(motionTask, "motion", MOTION_TASK_STACK, nullptr, MOTION_TASK_PRIORITY,
+                            &motionTaskHandle, MOTION_TASK_CORE);
+    mqttManager.setExecutorTask(motionTaskHandle);
+    xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, nullptr, NETWORK_TASK_PRIORITY,
+                            &networkTaskHandle, NETWORK_TASK_CORE);
 }
 
 void loop() {
-    motorController.checkIdle();
+    vTaskDelete(nullptr); // all work runs in the motion and network tasks
+}
+
+// Owns the MotorController: state machine, servo phases, queued commands and token entry
+static void motionTask(void* param) {
+    for (;;) {
+        motorController.update();
+        motorController.checkIdle();
+        mqttManager.processCommands();
+
+        bool active = motorController.isBusy() || mqttManager.isExecuting();
+        ulTaskNotifyTake(pdTRUE, active ? MOTION_ACTIVE_PERIOD : MOTION_IDLE_PERIOD);
+    }
+}
+
+// Owns WiFi and the MQTT client: reconnects, attribute requests and telemetry
+static void networkTask(void* param) {
+    for (;;) {
+        networkLoop();
+        vTaskDelay(NETWORK_PERIOD);
+    }
+}
+
+static void networkLoop() {
     mqttManager.loop();
-    mqttManager.processCommands();
+    handleSerialCommand();
 
     unsigned long now = millis();
 
@@ -87,34 +132,50 @@ void loop() {
             }
         }
     } else {
-        // WiFi is connected — reset counters and handle MQTT reconnects
+        // WiFi is connected — reset counters, MQTT reconnects itself from mqttManager.loop()
         if (wifiFailedReconnects != 0) wifiFailedReconnects = 0;
+    }
 
-        if (!mqttManager.is_connected()) {
-            if (now - lastMqttAttempt >= MQTT_RECONNECT_INTERVAL) {
-                lastMqttAttempt = now;
-                Serial.println("MQTT disconnected. Attempting to reconnect...");
-                mqttManager.connect();
-            }
-        }
+    if (mqttManager.is_connected() && now - lastMqttSubLog >= MQTT_SUB_LOG_INTERVAL) {
+        lastMqttSubLog = now;
+        mqttManager.printSubTick();
     }
 
-    if (mqttManager.is_connected()) {
-        if (now - lastMqttSubReq >= MQTT_SUB_POLL_INTERVAL) {
-            lastMqttSubReq = now;
-            mqttManager.requestShared();
-        }
+    // Sampled online or not: offline, flushTelemetry() spills the samples to the journal
+    if (now - lastMqttPub >= MQTT_PUB_INTERVAL) {
+        lastMqttPub = now;
+        mqttManager.publishTelemetry();
+    }
+}
 
-        if (now - lastMqttSubLog >= MQTT_SUB_LOG_INTERVAL) {
-            lastMqttSubLog = now;
-            mqttManager.printSubTick();
+// Serial console: "stats" dumps the motion histograms, "stats reset" clears them
+static void handleSerialCommand() {
+    static char line[32];
+    static uint8_t len = 0;
+
+    while (Serial.available()) {
+        char c = Serial.read();
+        if (c == '\r') continue;
+        if (c != '\n') {
+            if (len < sizeof(line) - 1) line[len++] = c;
+            continue;
         }
-
-        if (now - lastMqttPub >= MQTT_PUB_INTERVAL) {
-            lastMqttPub = now;
-            mqttManager.publishTelemetry();
+        line[len] = '\0';
+        len = 0;
+
+        if (strcmp(line, "stats") == 0) {
+#if APTL_MOTION_STATS
+            motorController.getStats().dump(Serial);
+#else
+            Serial.println("Motion statistics are disabled in this build.\n");
+#endif
+        } else if (strcmp(line, "stats reset") == 0) {
+#if APTL_MOTION_STATS
+            motorController.resetStats();
+            Serial.println("Motion statistics cleared.\n");
+#endif
+        } else if (line[0]) {
+            Serial.printf("Unknown command: %s\n", line);
         }
     }
-    
-    delay(50);
 }
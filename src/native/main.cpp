@@ -0,0 +1,99 @@
+// Host build (env:native): the firmware managers on the HAL fakes, in virtual time.
+// Runs the same setup as src/main.cpp, then the motion and network task bodies from
+// one loop for the given number of simulated seconds (default 60), and prints a summary.
+//
+//   pio run -e native && .pio/build/native/program [seconds]
+
+#include <Arduino.h>
+#include <chrono>
+#include "hal.h"
+#include "halFakes.h"
+#include "deviceConfig.h"
+#include "fsManager.h"
+#include "wifiManager.h"
+#include "mqttManager.h"
+#include "motorController.h"
+
+FSManager fsManager;
+WifiManager wifiManager;
+MqttManager mqttManager;
+MotorController motorController;
+
+static const unsigned long MOTION_PERIOD_MS  = 1; // As MOTION_ACTIVE_PERIOD in src/main.cpp
+static const unsigned long NETWORK_PERIOD_MS = 5;
+static const unsigned long MQTT_PUB_INTERVAL = 1000;
+static const long CARRIAGE_START_STEPS       = 1000; // Below the top limit switch at power-up
+
+// Carriage on the belt: counts step pulses and closes the top limit switch at the top,
+// so homing has something to find
+class CarriageGpio : public FakeGpio {
+public:
+    CarriageGpio() : position(CARRIAGE_START_STEPS) {}
+
+    void digitalWrite(uint8_t pin, uint8_t value) override {
+        bool rising = pin == STEP_PIN && value == HIGH && level[pin] == LOW;
+        FakeGpio::digitalWrite(pin, value);
+        if (!rising) return;
+        position += level[DIR_PIN] == HIGH ? 1 : -1;
+        set(LIMIT_PIN_TOP, position <= 0 ? LOW : HIGH);
+    }
+
+    long getPosition() const { return position; }
+
+private:
+    long position; // Steps below the switch
+};
+
+static CarriageGpio carriage;
+
+int main(int argc, char** argv) {
+    unsigned long runMs = (argc > 1 ? strtoul(argv[1], nullptr, 10) : 60) * 1000UL;
+    halSetGpio(&carriage);
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+
+    //* Setup, as on the board
+    Serial.println("\n\nStarting APTL firmware (native)...\n");
+    setDeviceID(halWiFi().macAddress());
+    fsManager.init();
+
+    wifiManager.init(getWiFiSSID(), getWiFiPassword());
+    wifiManager.connect();
+    mqttManager.init(getMqttIP(), getMqttPort(), getDeviceID(), getMqttToken(), nullptr);
+    mqttManager.connect();
+
+    motorController.setup();
+    bool homed = !motorController.needsHoming() || motorController.calibrate();
+    printConfig();
+
+    //* Task bodies, interleaved
+    unsigned long start = halMillis(), lastNetwork = start, lastPub = start;
+    while (halMillis() - start < runMs) {
+        motorController.update();
+        motorController.checkIdle();
+        mqttManager.processCommands();
+
+        unsigned long now = halMillis();
+        if (now - lastNetwork >= NETWORK_PERIOD_MS) {
+            lastNetwork = now;
+            mqttManager.loop();
+            if (now - lastPub >= MQTT_PUB_INTERVAL) {
+                lastPub = now;
+                mqttManager.publishTelemetry();
+            }
+        }
+        halDelay(MOTION_PERIOD_MS);
+    }
+
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+    Serial.println("===== Native run =====");
+    Serial.printf("Simulated: %lu ms, wall clock: %.1f ms\n", halMillis(), wallMs);
+    Serial.printf("Homing: %s in %lu ms, carriage %ld steps below the switch\n", homed ? "done" : "FAILED",
+                  motorController.getHomingDurationMs(), carriage.getPosition());
+    Serial.printf("Step timer alarms: %llu, WiFi: %s, MQTT: %s\n", (unsigned long long)halFakes().timer.getFired(),
+                  wifiManager.getConnectionStatus() ? "connected" : "down",
+                  mqttManager.is_connected() ? "connected" : "not connected (no broker on the host)");
+#if APTL_MOTION_STATS
+    motorController.getStats().dump(Serial);
+#endif
+    return homed ? 0 : 1;
+}
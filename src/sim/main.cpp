@@ -0,0 +1,259 @@
+// Token entry bench (env:native-sim): the firmware on a simulated rig (KeypadSimulator),
+// in virtual time. Each kodetoken arrives as a shared attribute push over a loopback MQTT
+// transport and runs through processCommands() like on the board; the simulator records
+// which keys the plungers actually registered.
+//
+//   pio run -e native-sim && .pio/build/native-sim/program [tokens] [kodetoken]
+//
+// Tokens default to 20 random 20-digit ones from a fixed seed, so runs compare across
+// builds. Prints per-digit timing and travel for each token and tokens/hour at the end;
+// exits non-zero when a token failed or entered the wrong keys, or the rig lost steps,
+// moved with a plunger down or missed a press.
+
+#include <Arduino.h>
+#include <chrono>
+#include <vector>
+#include "hal.h"
+#include "halFakes.h"
+#include "deviceConfig.h"
+#include "fsManager.h"
+#include "wifiManager.h"
+#include "mqttManager.h"
+#include "motorController.h"
+#include "keypadSimulator.h"
+
+FSManager fsManager;
+WifiManager wifiManager;
+MqttManager mqttManager;
+MotorController motorController;
+
+#define SIM_DEFAULT_TOKENS 20
+#define SIM_TOKEN_DIGITS 20
+#define SIM_TOKEN_TIMEOUT_MS 120000UL
+#define SIM_SEED 20240901UL
+
+// As the task periods in src/main.cpp
+static const unsigned long MOTION_ACTIVE_MS = 1;
+static const unsigned long MOTION_IDLE_MS   = 20;
+static const unsigned long NETWORK_MS       = 5;
+static const unsigned long MQTT_PUB_INTERVAL = 1000;
+
+static const char TOPIC_PUSH[] = "v1/devices/me/attributes";
+static const char TOPIC_REQ_PREFIX[] = "v1/devices/me/attributes/request/";
+static const char TOPIC_RESP_PREFIX[] = "v1/devices/me/attributes/response/";
+
+// Broker and server in one: always connected, answers attribute requests with no
+// attributes and delivers pushes from the next poll()
+class LoopbackTransport : public MqttTransport {
+public:
+    bool begin(const IPAddress&, uint16_t, uint16_t, uint16_t, uint16_t, MessageCallback callback) override {
+        this->callback = callback;
+        return true;
+    }
+    bool connect(const char*, const char*, const char*) override { return isConnected = true; }
+    bool connected() override { return isConnected; }
+    int state() override { return isConnected ? MQTT_STATE_CONNECTED : MQTT_STATE_DISCONNECTED; }
+    bool subscribe(const char*) override { return true; }
+
+    void poll() override {
+        std::vector<std::pair<String, String> > batch;
+        batch.swap(inbox);
+        for (size_t i = 0; i < batch.size(); i++) {
+            String& topic = batch[i].first;
+            String& payload = batch[i].second;
+            if (callback) callback(&topic[0], (uint8_t*)&payload[0], payload.length());
+        }
+    }
+
+    bool publish(const char* topic, const uint8_t*, size_t length, uint8_t) override {
+        published++;
+        publishedBytes += length;
+        if (strncmp(topic, TOPIC_REQ_PREFIX, sizeof(TOPIC_REQ_PREFIX) - 1) == 0) {
+            deliver((String(TOPIC_RESP_PREFIX) + (topic + sizeof(TOPIC_REQ_PREFIX) - 1)).c_str(), "{}");
+        }
+        return true;
+    }
+
+    void deliver(const char* topic, const String& payload) { inbox.push_back(std::make_pair(String(topic), payload)); }
+    uint32_t getPublished() const { return published; }
+    uint32_t getPublishedBytes() const { return publishedBytes; }
+
+private:
+    MessageCallback callback = nullptr;
+    bool isConnected = false;
+    std::vector<std::pair<String, String> > inbox;
+    uint32_t published = 0;
+    uint32_t publishedBytes = 0;
+};
+
+static KeypadSimulator rig;
+static LoopbackTransport broker;
+static HostFilesystem simFs(".native_sim_fs");
+static TaskHandle_t motionTask = nullptr;
+static unsigned long nextMotion = 0, nextNetwork = 0, lastPub = 0;
+
+//* Task bodies, scheduled like the two FreeRTOS tasks
+static void runFor(unsigned long ms, bool (*done)() = nullptr) {
+    unsigned long start = halMillis();
+    while (halMillis() - start < ms) {
+        unsigned long now = halMillis();
+        if (hostTaskNotifyTake(motionTask) || (long)(now - nextMotion) >= 0) {
+            motorController.update();
+            motorController.checkIdle();
+            mqttManager.processCommands();
+            bool active = motorController.isBusy() || mqttManager.isExecuting();
+            nextMotion = now + (active ? MOTION_ACTIVE_MS : MOTION_IDLE_MS);
+        }
+        if ((long)(now - nextNetwork) >= 0) {
+            nextNetwork = now + NETWORK_MS;
+            mqttManager.loop();
+            if (now - lastPub >= MQTT_PUB_INTERVAL) {
+                lastPub = now;
+                mqttManager.publishTelemetry();
+            }
+        }
+        if (done && done()) return;
+        halDelay(1);
+    }
+}
+
+static bool tokenStarted = false;
+
+static bool tokenFinished() {
+    bool running = mqttManager.isExecuting() || motorController.isBusy();
+    if (running) tokenStarted = true;
+    return tokenStarted && !running;
+}
+
+// Keys the firmware should press for a kodetoken, as TokenSequencer::compile() reads it
+static std::vector<uint8_t> expectedKeys(const String& token) {
+    std::vector<uint8_t> keys;
+    for (size_t i = 0; i < token.length(); i++) {
+        char c = token[i];
+        if (isdigit(static_cast<unsigned char>(c))) keys.push_back(c - '0');
+        else if (c == TOKEN_CHAR_BACKSPACE) keys.push_back(BUTTON_BACKSPACE);
+        else if (c == TOKEN_CHAR_SUBMIT) keys.push_back(BUTTON_SUBMIT);
+    }
+    if (TOKEN_AUTO_SUBMIT && (keys.empty() || keys.back() != BUTTON_SUBMIT)) keys.push_back(BUTTON_SUBMIT);
+    return keys;
+}
+
+static String randomToken() {
+    String token;
+    for (uint8_t i = 0; i < SIM_TOKEN_DIGITS; i++) token += (char)('0' + random(10));
+    return token;
+}
+
+static const char* keyName(uint8_t button) {
+    static char name[4];
+    if (button == BUTTON_BACKSPACE) return "<";
+    if (button == BUTTON_SUBMIT) return "#";
+    if (button > 9) return "?";
+    snprintf(name, sizeof(name), "%u", button);
+    return name;
+}
+
+// Runs one token, prints its breakdown; false if it failed or entered other keys
+static bool runToken(uint16_t n, uint16_t total, const String& token, uint64_t& runUs, uint32_t& travelSteps) {
+    std::vector<uint8_t> expected = expectedKeys(token);
+
+    tokenStarted = false;
+    rig.beginRun();
+    broker.deliver(TOPIC_PUSH, "{\"kodetoken\":\"" + token + "\"}");
+    runFor(SIM_TOKEN_TIMEOUT_MS, tokenFinished);
+    rig.endRun();
+    bool finished = tokenStarted && !mqttManager.isExecuting() && !motorController.isBusy();
+    broker.deliver(TOPIC_PUSH, "{\"kodetoken\":\"\"}"); // So the same kodetoken can be sent again
+    runFor(NETWORK_MS);
+
+    Serial.printf("\n----- Token %u/%u: %s -----\n", n, total, token.c_str());
+    Serial.println("  #  key line servo   span ms   move ms  press ms  travel mm");
+    uint8_t matched = 0;
+    for (uint8_t i = 0; i < rig.getKeyCount(); i++) {
+        const KeypadSimulator::KeyEvent& key = rig.getKey(i);
+        bool ok = i < expected.size() && key.button == expected[i];
+        if (ok) matched++;
+        Serial.printf("%3u  %3s %4u %5u %9.1f %9.1f %9.1f %10.1f%s\n", i + 1, keyName(key.button), key.line, key.servo,
+                      key.spanUs / 1000.0, key.moveUs / 1000.0, key.pressUs / 1000.0,
+                      key.travelSteps / (float)STEPS_PER_MM, ok ? "" : "  <- wrong key");
+    }
+
+    runUs = rig.getRunUs();
+    travelSteps = rig.getRunTravelSteps();
+    bool ok = finished && matched == expected.size() && rig.getKeyCount() == expected.size();
+    Serial.printf("  tail %.1f ms (return home)\n", rig.getTailUs() / 1000.0);
+    Serial.printf("  total %.1f ms, travel %.1f mm, keys %u/%u %s\n", runUs / 1000.0,
+                  travelSteps / (float)STEPS_PER_MM, matched, (unsigned)expected.size(),
+                  !finished ? "TIMEOUT" : ok ? "OK" : "WRONG");
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    uint16_t tokens = argc > 1 ? strtoul(argv[1], nullptr, 10) : SIM_DEFAULT_TOKENS;
+    String fixedToken = argc > 2 ? String(argv[2]) : String();
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    randomSeed(SIM_SEED);
+
+    //* Rig and firmware setup, as on the board
+    simFs.format(); // Every run starts from the default config
+    halSetFilesystem(&simFs);
+    rig.install();
+    motionTask = hostTaskCreate();
+    mqttManager.setTransport(&broker);
+
+    Serial.println("\n\nStarting APTL firmware (token bench)...\n");
+    setDeviceID(halWiFi().macAddress());
+    fsManager.init();
+
+    // Calibration of the simulated keypad: where its lines are seen from home
+    std::map<int, float> lines;
+    for (uint8_t line = 1; line <= 4; line++) lines[line] = rig.lineCoordinate(line);
+    setLineCoordinates(lines);
+    setMaxPosition(rig.maxPosition());
+    setKeypadLayout(DEFAULT_KEYPAD_LAYOUT);
+
+    wifiManager.init(getWiFiSSID(), getWiFiPassword());
+    wifiManager.connect();
+    mqttManager.init(getMqttIP(), getMqttPort(), getDeviceID(), getMqttToken(), nullptr);
+    mqttManager.connect();
+
+    motorController.setup();
+    motorController.setMaximumPosition(rig.maxPosition());
+    bool homed = !motorController.needsHoming() || motorController.calibrate();
+    printConfig();
+    mqttManager.setExecutorTask(motionTask);
+    runFor(1000); // Connect and sync attributes before the first token
+
+    //* Tokens
+    uint16_t failed = 0;
+    uint64_t sumUs = 0, minUs = UINT64_MAX, maxUs = 0, travel = 0;
+    for (uint16_t i = 1; i <= tokens && homed; i++) {
+        uint64_t runUs;
+        uint32_t travelSteps;
+        if (!runToken(i, tokens, fixedToken.length() ? fixedToken : randomToken(), runUs, travelSteps)) failed++;
+        sumUs += runUs;
+        travel += travelSteps;
+        if (runUs < minUs) minUs = runUs;
+        if (runUs > maxUs) maxUs = runUs;
+    }
+
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+    double meanMs = tokens ? sumUs / 1000.0 / tokens : 0;
+    Serial.println("\n===== Token bench =====");
+    Serial.printf("Homing: %s in %lu ms, switch at %.1f mm, home at %.1f mm\n", homed ? "done" : "FAILED",
+                  motorController.getHomingDurationMs(), SIM_TOP_SWITCH_MM, rig.homeMm());
+    if (homed && tokens) {
+        Serial.printf("Tokens: %u, %u failed\n", tokens, failed);
+        Serial.printf("Duration: mean %.1f ms, min %.1f ms, max %.1f ms\n", meanMs, minUs / 1000.0, maxUs / 1000.0);
+        Serial.printf("Travel: %.1f mm per token\n", travel / (float)STEPS_PER_MM / tokens);
+        Serial.printf("Throughput: %.1f tokens/hour\n", meanMs > 0 ? 3600000.0 / meanMs : 0.0);
+    }
+    Serial.printf("Rig: %u lost steps, %u steps with a plunger down, %u missed presses, peak %u steps/s\n",
+                  (unsigned)rig.getLostSteps(), (unsigned)rig.getCollisions(), (unsigned)rig.getMissedPresses(),
+                  (unsigned)rig.getMaxStepRate());
+    Serial.printf("MQTT: %u messages published, %u bytes\n", (unsigned)broker.getPublished(), (unsigned)broker.getPublishedBytes());
+    Serial.printf("Simulated: %lu ms, wall clock: %.1f ms\n", halMillis(), wallMs);
+
+    bool clean = rig.getLostSteps() == 0 && rig.getCollisions() == 0 && rig.getMissedPresses() == 0;
+    return homed && failed == 0 && clean ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+// TelemetryBuffer on the host: pio test -e native -f test_telemetryBuffer
+
+#include <unity.h>
+#include "telemetryBuffer.h"
+
+static const TelemetryKey KEYS[] = {
+    {"posisi",     0.5f, false},
+    {"statusaptl", 0,    true},
+};
+
+void setUp() {}
+void tearDown() {}
+
+static void test_status_change_is_urgent() {
+    TelemetryBuffer buffer(KEYS, 2);
+    float v[2] = {10, 0};
+    TEST_ASSERT_TRUE(buffer.sample(v, 1000)); // First sample records every key
+    buffer.consume(buffer.depth());
+
+    v[1] = 2;
+    TEST_ASSERT_TRUE(buffer.sample(v, 2000));
+    TEST_ASSERT_TRUE(buffer.flushDue(2000));
+}
+
+static void test_position_change_waits_for_flush() {
+    TelemetryBuffer buffer(KEYS, 2);
+    float v[2] = {10, 0};
+    buffer.sample(v, 1000);
+    buffer.consume(buffer.depth());
+
+    v[0] = 20;
+    TEST_ASSERT_TRUE(buffer.sample(v, 2000));
+    TEST_ASSERT_FALSE(buffer.flushDue(2000));
+    TEST_ASSERT_TRUE(buffer.flushDue(2000 + TELEMETRY_FLUSH_MS));
+}
+
+static void test_status_change_at_heartbeat_is_urgent() {
+    TelemetryBuffer buffer(KEYS, 2);
+    float v[2] = {10, 0};
+    buffer.sample(v, 1000);
+    buffer.consume(buffer.depth());
+
+    unsigned long heartbeat = 1000 + TELEMETRY_HEARTBEAT_MS;
+    TEST_ASSERT_TRUE(buffer.sample(v, heartbeat)); // Unchanged heartbeat: recorded, not urgent
+    TEST_ASSERT_FALSE(buffer.flushDue(heartbeat));
+    buffer.consume(buffer.depth());
+
+    v[1] = 2;
+    heartbeat += TELEMETRY_HEARTBEAT_MS;
+    TEST_ASSERT_TRUE(buffer.sample(v, heartbeat));
+    TEST_ASSERT_EQUAL_UINT32(0x3, buffer.peek(0).mask);
+    TEST_ASSERT_TRUE(buffer.flushDue(heartbeat));
+}
+
+static void test_status_at_first_sample_is_urgent() {
+    TelemetryBuffer buffer(KEYS, 2);
+    float v[2] = {10, 3};
+    TEST_ASSERT_TRUE(buffer.sample(v, 1000));
+    TEST_ASSERT_TRUE(buffer.flushDue(1000));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_status_change_is_urgent);
+    RUN_TEST(test_position_change_waits_for_flush);
+    RUN_TEST(test_status_change_at_heartbeat_is_urgent);
+    RUN_TEST(test_status_at_first_sample_is_urgent);
+    return UNITY_END();
+}
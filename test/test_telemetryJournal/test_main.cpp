@@ -0,0 +1,108 @@
+// TelemetryJournal on the host filesystem: pio test -e native -f test_telemetryJournal
+
+#include <unity.h>
+#include "hal.h"
+#include "halFakes.h"
+#include "telemetryJournal.h"
+
+static const int64_t EPOCH_MS = 1700000000000LL;
+
+static HostFilesystem fs(".native_fs_test");
+
+void setUp() {
+    halSetFilesystem(&fs);
+    fs.format(); // Also drops the boot counter
+}
+
+void tearDown() {}
+
+static TelemetrySample makeSample(unsigned long ms, float value) {
+    TelemetrySample s = {};
+    s.ms = ms;
+    s.mask = 0x1;
+    s.values[0] = value;
+    return s;
+}
+
+static void appendOne(TelemetryJournal& journal, unsigned long ms, float value, int64_t ts) {
+    TelemetrySample s = makeSample(ms, value);
+    const TelemetrySample* batch[1] = {&s};
+    TEST_ASSERT_TRUE(journal.append(batch, &ts, 1));
+}
+
+static void test_timed_records_replay_in_order() {
+    TelemetryJournal journal;
+    journal.begin();
+    appendOne(journal, 1000, 1, EPOCH_MS);
+    appendOne(journal, 2000, 2, EPOCH_MS + 1000);
+
+    TelemetrySample samples[JOURNAL_REPLAY_RECORDS];
+    int64_t ts[JOURNAL_REPLAY_RECORDS];
+    TEST_ASSERT_EQUAL_UINT8(2, journal.read(samples, ts, JOURNAL_REPLAY_RECORDS, 0, 3000));
+    TEST_ASSERT_EQUAL_INT64(EPOCH_MS, ts[0]);
+    TEST_ASSERT_EQUAL_INT64(EPOCH_MS + 1000, ts[1]);
+    journal.commitRead(2);
+    TEST_ASSERT_TRUE(journal.isEmpty());
+}
+
+static void test_untimed_record_dated_once_the_clock_is_set() {
+    TelemetryJournal journal;
+    journal.begin();
+    appendOne(journal, 1000, 1, 0);
+
+    TelemetrySample samples[JOURNAL_REPLAY_RECORDS];
+    int64_t ts[JOURNAL_REPLAY_RECORDS];
+    TEST_ASSERT_EQUAL_UINT8(0, journal.read(samples, ts, JOURNAL_REPLAY_RECORDS, 0, 5000));
+    TEST_ASSERT_EQUAL_UINT8(1, journal.read(samples, ts, JOURNAL_REPLAY_RECORDS, EPOCH_MS, 5000));
+    TEST_ASSERT_EQUAL_INT64(EPOCH_MS - 4000, ts[0]);
+}
+
+// SNTP never syncs (LAN-only broker): past the wait, untimed records go out without ts
+// and the timed ones behind them are not held back
+static void test_never_synced_clock_does_not_block_replay() {
+    TelemetryJournal journal;
+    journal.begin();
+    appendOne(journal, 1000, 1, 0);
+    appendOne(journal, 2000, 2, EPOCH_MS);
+    appendOne(journal, 3000, 3, 0);
+
+    TelemetrySample samples[JOURNAL_REPLAY_RECORDS];
+    int64_t ts[JOURNAL_REPLAY_RECORDS];
+    TEST_ASSERT_EQUAL_UINT8(0, journal.read(samples, ts, JOURNAL_REPLAY_RECORDS, 0, JOURNAL_CLOCK_WAIT_MS - 1));
+
+    uint8_t n = journal.read(samples, ts, JOURNAL_REPLAY_RECORDS, 0, JOURNAL_CLOCK_WAIT_MS);
+    TEST_ASSERT_EQUAL_UINT8(3, n);
+    TEST_ASSERT_EQUAL_INT64(0, ts[0]);
+    TEST_ASSERT_EQUAL_INT64(EPOCH_MS, ts[1]);
+    TEST_ASSERT_EQUAL_INT64(0, ts[2]);
+    TEST_ASSERT_TRUE(samples[2].values[0] == 3);
+    journal.commitRead(n);
+    TEST_ASSERT_TRUE(journal.isEmpty());
+}
+
+// After a reboot an untimed record cannot be dated: dropped, the rest still replays
+static void test_untimed_record_from_an_earlier_boot_dropped() {
+    {
+        TelemetryJournal before;
+        before.begin();
+        appendOne(before, 1000, 1, 0);
+        appendOne(before, 2000, 2, EPOCH_MS);
+    }
+    TelemetryJournal journal;
+    journal.begin();
+
+    TelemetrySample samples[JOURNAL_REPLAY_RECORDS];
+    int64_t ts[JOURNAL_REPLAY_RECORDS];
+    TEST_ASSERT_EQUAL_UINT8(1, journal.read(samples, ts, JOURNAL_REPLAY_RECORDS, 0, 1000));
+    TEST_ASSERT_EQUAL_INT64(EPOCH_MS, ts[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, journal.getUntimedDropped());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_timed_records_replay_in_order);
+    RUN_TEST(test_untimed_record_dated_once_the_clock_is_set);
+    RUN_TEST(test_never_synced_clock_does_not_block_replay);
+    RUN_TEST(test_untimed_record_from_an_earlier_boot_dropped);
+    return UNITY_END();
+}